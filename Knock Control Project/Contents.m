@@ -5,17 +5,53 @@
 %   normCdf    - nCdf Normalize cumulative density function data
 %   p2x        - p2x Evaluate/look-up inverse empirical cumulative density function F^-1(p)
 %   x2p        - x2p Evaluate/look-up empirical cumulative density function p=F(x)
+%   aliasCdf   - aliasCdf Alias tables for constant time sampling of empirical knock intensity distributions
+%   aliasRand  - aliasRand Constant time sampling of knock intensities from alias tables
 %   optTx      - optTx Computes optimized knock thresholds
 %   knockP     - knockP Computes knock probability curves
+%   replayTx   - replayTx Bit-sliced replay of up to 64 knock thresholds over knock intensity traces
+%   popCount   - popCount Number of set bits in each element of an unsigned integer array
+%   opMap      - opMap Speed/load operating point map of knock probability curves and thresholds
+%   opKnockP   - opKnockP Knock probability look-up from a speed/load operating point map
 %
 % Stochastic Simulation - Traditional Controller
 %   markovMx   - markovMx Construct state transition matrices for a traditional knock controller
+%   markovMxNU - markovMxNU Construct state transition matrices for a traditional knock controller on a non-uniform grid
+%   thetaGrid  - thetaGrid Non-uniform controller state grid adapted to the knock probability curve
+%   lumpMx     - lumpMx Lumped (reduced) state transition matrices for quantized actuator states
 %   pdfSpk     - pdfSpk Probability density function of closed-loop relative spark advance
 %   pdfKnk     - pdfKnk Distribution of number of knock events in first n cycles
+%   tailKnk    - tailKnk Underflow-safe tail probabilities of the number of knock events in n cycles
 %   mKnk       - mKnk Mean (closed-loop) number of knock events in first n cycles
 %   mSpk       - mSpk Mean closed-loop spark angle, time-averaged over the first n cycles
 %   respT      - respT Transient response statistics for a traditional knock controller
+%   driveKnk   - driveKnk Time-inhomogeneous Markov chain analysis of a knock controller over a drive cycle
+%   mixKnk     - mixKnk Spectral gap, mixing time and slowest modes of a knock controller Markov chain
+%   sensKnk    - sensKnk Adjoint sensitivities of steady state knock control metrics to the gains, knock probabilities and threshold
+%   kpiKnk     - kpiKnk Knock control performance metrics of plotDriver, from the empirical cdfs of a spark sweep
+%   bootKnk    - bootKnk Bootstrap confidence intervals on the knock control metrics of plotDriver
+%   cylKnk     - cylKnk Knock control analysis of plotDriver for every cylinder of an engine
 %   compress   - Deals with repeated values in pdfPoints and hence in pdf
 %
+% Stochastic Simulation - Monte Carlo
+%   knCtrl     - knCtrl Traditional knock controller step, vectorized over many controller instances
+%   knLearn    - knLearn Adaptive (borderline learning) knock controller step, vectorized over many controller instances
+%   castCtl    - castCtl Cast knock controller parameters to a fixed-point or single precision data type
+%   driftCtl   - driftCtl Accuracy of fixed-point and single precision knock controller variants
+%   simKnk     - simKnk Monte Carlo closed-loop simulation of a traditional knock controller
+%   latKnk     - latKnk Monte Carlo closed-loop simulation of a traditional knock controller on the Markov chain state lattice
+%   snapKnk    - snapKnk Compact binary snapshot of a Monte Carlo knock control simulation state
+%   forkKnk    - forkKnk Branch many Monte Carlo continuations from a knock control simulation state
+%   rareKnk    - rareKnk Importance sampling estimate of the probability of a burst of consecutive knock events
+%   xvalKnk    - xvalKnk Cross-validation of the Markov chain analysis against Monte Carlo simulation
+%   pairKnk    - pairKnk Paired comparison of knock controller calibrations using common random numbers
+%   knkTrace   - knkTrace Bit-packed knock event trace
+%   knkStats   - knkStats Knock counts, sliding window counts, bursts and inter-knock intervals of a packed knock trace
+%
+% Benchmarks
+%   benchKnk   - benchKnk Scaling benchmarks for the knock controller simulation and analysis kernels
+%   schedKnk   - schedKnk Dynamically load balanced execution of heterogeneous simulation and analysis jobs
+%   recovKnk   - recovKnk Recovery of the traditional and borderline learning knock controllers on re-entry to an operating point
+%
 % Demo / Example
 %   demo       - 
@@ -0,0 +1,101 @@
+function tbl= aliasCdf(cdfData,theta,cyl)
+
+% aliasCdf Alias tables for constant time sampling of empirical knock intensity distributions
+%
+% Syntax
+% tbl= aliasCdf(cdfData)
+% tbl= aliasCdf(cdfData,theta)
+% tbl= aliasCdf(cdfData,theta,cyl)
+%
+% Description
+% |tbl= aliasCdf(cdfData,theta)| precomputes a Walker/Vose alias table for the knock intensity
+% distributions at the spark angle states |theta|, and for each cylinder, from the empirical cdf
+% data |cdfData| of a spark sweep, (see eCdf), so that aliasRand can then draw intensities in
+% constant time per draw, independent of the number of recorded cycles.  If |theta| is empty or
+% omitted, the sweep points |[cdfData.theta]| are used.
+%
+% The intensity distribution is the same as that of the |cdfData| plant of simKnk:  the quantile
+% function of each state is the empirical quantile function, (the piecewise linear inverse of the
+% cdf, as in p2x), of the two adjacent sweep points, mixed linearly in spark angle, (and held
+% beyond them), ie. |x(u)= (1-f)*Qa(u) + f*Qb(u)|.  This quantile function is piecewise linear
+% between the union |tbl.u| of the cdf levels |Fx| of all the sweep experiments, so each interval
+% of |tbl.u| is one bin of the alias table, with probability equal to its width, and the same
+% table serves every state and cylinder.  Within a bin the intensity is uniform between the
+% quantiles at its edges.  Between adjacent states aliasRand mixes the quantiles linearly, so the
+% two plants are interchangeable at any spark angle when |theta| contains the sweep points, (eg.
+% the default), and agree at the states |theta| otherwise.
+%
+% |tbl= aliasCdf(cdfData,theta,cyl)| constructs the tables only for the cylinder(s) |cyl|.
+%
+% The output structure |tbl| contains the fields |theta|, |cyl|, |u|, the cdf levels of the bin
+% edges, |prob| and |alias|, the |[numBins x 1]| acceptance probability and alias bin of each bin,
+% and |q|, the |[(numBins+1) x numStates x length(cyl)]| quantiles at the bin edges.
+
+% Examples
+% myCdf= eCdf(xi,theta);                        % Empirical cdf for all cylinders and spark conditions
+% tbl= aliasCdf(myCdf);                         % Alias table at the sweep points
+% x= aliasRand(tbl,relSpk,rand(size(relSpk)));  % One intensity per instance
+% plant= struct('alias',tbl,'cyl',1);           % Alias table intensity plant for simKnk
+%
+% See also
+% aliasRand eCdf p2x simKnk
+
+
+% Check input arguments
+if ~isa(cdfData,'struct'), error('cdfData should be a struct with fields x, Fx and theta'); end;
+if (nargin<2)||isempty(theta), theta= [cdfData.theta]; end;
+if (nargin<3)||isempty(cyl), cyl= [1:size(cdfData(1).x,2)]; end;
+theta= theta(:);
+thetaE= [cdfData.theta];
+numE= length(thetaE);
+numStates= length(theta);
+
+% Adjacent sweep experiments, and interpolation weight, of each state, (as simKnk)
+iE= ones(numStates,1);
+f= zeros(numStates,1);
+if numE>1,
+    f= interp1(thetaE(:),[0:numE-1]',min(max(theta,thetaE(1)),thetaE(end)));
+    iE= min(floor(f),numE-2);
+    f= f-iE;
+    iE= iE+1;
+end;
+iE2= min(iE+1,numE);
+
+% Bin edges, the union of the cdf levels, and the alias table of the bin probabilities
+u= unique(vertcat(cdfData.Fx));
+[prob,alias]= vose(diff(u));
+tbl.theta= theta;
+tbl.cyl= cyl;
+tbl.u= u;
+tbl.prob= prob;
+tbl.alias= alias;
+
+% Quantiles of each state and cylinder at the bin edges, (quantile mixing, as simKnk)
+Q= zeros(length(u),numE,length(cyl));
+for k=1:numE,
+    for j=1:length(cyl),
+        Q(:,k,j)= interp1(cdfData(k).Fx,cdfData(k).x(:,cyl(j)),u);
+    end;
+end;
+tbl.q= bsxfun(@times,Q(:,iE,:),(1-f)') + bsxfun(@times,Q(:,iE2,:),f');
+
+
+
+function [prob,alias]= vose(w)
+
+% Vose's alias method:  acceptance probabilities and aliases for the bin weights w
+L= length(w);
+q= w*L/sum(w);
+prob= ones(L,1);
+alias= uint32([1:L]');
+small= zeros(L,1); large= zeros(L,1);
+i= find(q<1); ns= length(i); small(1:ns)= i;
+i= find(q>=1); nl= length(i); large(1:nl)= i;
+while (ns>0) && (nl>0),
+    s= small(ns); ns= ns-1;
+    l= large(nl);
+    prob(s)= q(s);
+    alias(s)= l;
+    q(l)= q(l) + q(s) - 1;
+    if q(l)<1, nl= nl-1; ns= ns+1; small(ns)= l; end;
+end;
@@ -0,0 +1,80 @@
+function x= aliasRand(tbl,relSpk,u,cyl,interp)
+
+% aliasRand Constant time sampling of knock intensities from alias tables
+%
+% Syntax
+% x= aliasRand(tbl,relSpk)
+% x= aliasRand(tbl,relSpk,u)
+% x= aliasRand(tbl,relSpk,u,cyl)
+% x= aliasRand(tbl,relSpk,u,cyl,interp)
+%
+% Description
+% |x= aliasRand(tbl,relSpk,u)| draws one knock intensity for each of the spark angles |relSpk|, from
+% the alias table |tbl|, (see aliasCdf), given the corresponding uniform random numbers |u|,
+% (default |rand(size(relSpk))|).  Each draw takes a fixed number of operations, independent of
+% the number of bins, and all draws are vectorized.  A single uniform number selects the bin,
+% makes the alias acceptance test, and positions the draw within the bin.  The quantiles at the
+% edges of the bin are mixed linearly between the two spark angle states adjacent to |relSpk|,
+% (clamped to the range of |tbl.theta|), as the quantiles of the sweep points are mixed by the
+% |cdfData| plant of simKnk, so the draws have the same distribution as that plant, (though not
+% the same value for a given |u|, since the alias draw is not the inverse transform).  The state
+% look-up is direct if the spark angle states are uniformly spaced.
+%
+% |x= aliasRand(tbl,relSpk,u,cyl)| samples the |cyl|-th cylinder of the table, ie. cylinder
+% |tbl.cyl(cyl)|, where |cyl| may be a scalar or one index per draw.  Default |cyl=1|.
+%
+% |x= aliasRand(tbl,relSpk,u,cyl,interp)| with |interp=false| returns the quantile at the upper
+% edge of the selected bin, (an empirical sample point at the sweep points), rather than
+% interpolating linearly within the bin.  The default |interp=true| reproduces the piecewise
+% linear empirical quantile function exactly.
+
+% Examples
+% tbl= aliasCdf(myCdf);
+% x= aliasRand(tbl,zeros(1e6,1));                 % 10^6 intensities at 0 deg, cylinder 1
+% mean(x>tradTx(1))                              % ...knock probability at the threshold
+%
+% See also
+% aliasCdf p2x simKnk
+
+
+% Check input arguments
+if (nargin<3)||isempty(u), u= rand(size(relSpk)); end;
+if (nargin<4)||isempty(cyl), cyl= 1; end;
+if (nargin<5)||isempty(interp), interp= true; end;
+numBins= length(tbl.prob);
+[numEdges,numStates,~]= size(tbl.q);
+
+% Adjacent spark angle states, and interpolation weight, of each draw
+theta= tbl.theta;
+relSpk= double(relSpk(:));
+if (numStates>1) && all(abs(diff(theta)-(theta(2)-theta(1)))<1e-9*max(abs(theta))+eps),
+    s= (min(max(relSpk,theta(1)),theta(end))-theta(1))/(theta(2)-theta(1));   % uniform states: direct indexing
+elseif numStates>1,
+    s= interp1(theta,[0:numStates-1]',min(max(relSpk,theta(1)),theta(end)));
+else
+    s= zeros(size(relSpk));
+end;
+s0= min(floor(s),max(numStates-2,0));
+f= s-s0;
+offset= numEdges*s0 + numEdges*numStates*(cyl(:)-1);
+next= numEdges*(numStates>1);
+
+% Alias draw:  bin k, acceptance test on the fractional part r, and alias bin if rejected
+v= u(:)*numBins;
+k= min(floor(v),numBins-1);
+r= v-k;
+j= k + 1;
+pr= tbl.prob(j);
+acc= r<pr;
+j(~acc)= double(tbl.alias(j(~acc)));
+
+% Quantiles at the bin edges, mixed between the adjacent states
+q= @(j) (1-f).*tbl.q(j+offset) + f.*tbl.q(j+offset+next);
+x= q(j+1);
+if interp,
+    t= (r-pr)./(1-pr);
+    t(acc)= r(acc)./pr(acc);
+    lo= q(j);
+    x= lo + t.*(x-lo);
+end;
+x= reshape(x,size(u));
@@ -0,0 +1,183 @@
+function results= benchKnk(Deltas,nCycles,fileName,maxFlops,maxBytes)
+
+% benchKnk Scaling benchmarks for the knock controller simulation and analysis kernels
+%
+% Syntax
+% results= benchKnk
+% results= benchKnk(Deltas,nCycles)
+% results= benchKnk(Deltas,nCycles,fileName)
+% results= benchKnk(Deltas,nCycles,fileName,maxFlops)
+% results= benchKnk(Deltas,nCycles,fileName,maxFlops,maxBytes)
+%
+% Description
+% |results= benchKnk| times each of the following kernels, for every algorithm resolution in the
+% default sweep |Deltas= [0.1 0.05 0.02 0.01 0.005 0.002 0.001 0.0005]| (and hence every number of
+% controller states), and every cycle horizon in the default sweep |nCycles= [100 1000 10000]|:
+%   'ctlStep'     scalar controller step, knCtrl, as in sf_gateway_c2_knock0
+%   'ctlStepVec'  controller step vectorized over 1000 instances
+%   'ctlLearnVec' borderline learning controller step, knLearn, vectorized over 1000 instances,
+%                 changing between 64 speed/load cells every 100 cycles
+%   'simKnk'      Monte Carlo closed loop simulation of 1000 runs
+%   'markovMx'    state transition matrix construction
+%   'ssSolve'     steady state pdf, pdfSpk(inf,...)
+%   'transient'   transient pdf propagation, pdfSpk([0:n],...)
+%   'pdfKnk'      distribution of the number of knock events in n cycles
+%   'respT'       transient response times and knock events
+%
+% The knock probability curve is the measured markovSim characteristic, interpolated onto the
+% state grid |theta= [-3.9:Delta:2]'|, and the controller has advance gain |Delta| and a fixed
+% retard gain of |round(1.485/Delta)*Delta| degrees, (m1=1, m2=99 at Delta=0.015).
+%
+% The output structure array |results| has one element per kernel, resolution and horizon with
+% fields |kernel|, |Delta|, |numStates|, |nCycles|, |numRuns|, |time| (best of up to 3 repeats,
+% in seconds), |bytes| (an estimate, from the array sizes, of the peak memory of the kernel's
+% working arrays, including the full matrices |M|, |Madv| and |Mret| held for the Markov chain
+% kernels), |outBytes| (the measured size of the kernel's output), |units| (the number of
+% controller steps, state-cycles or states processed), |throughput| (units per second) and
+% |status| ('ok' or 'skipped').  Kernels whose estimated cost exceeds |maxFlops|, (default
+% 1e11), or whose estimated memory |bytes| exceeds |maxBytes|, (default 2e9), are skipped before
+% they allocate anything, so that the scaling of the cheaper kernels can still be measured at the
+% finest resolutions.  The Markov chain kernels use the full matrices of markovMx, which need
+% |5*8*numStates^2| bytes, (about 5.6GB at |Delta= 0.0005|), so they are skipped at the finest
+% resolutions by default.
+%
+% |results= benchKnk(Deltas,nCycles,fileName)| also writes the results as comma separated values
+% to |fileName|, one line per result, for regression tracking.  By default no file is written.
+%
+% Examples
+% results= benchKnk([],[],'benchKnk.csv');                % Full sweep, written to benchKnk.csv
+% results= benchKnk([0.05 0.015],[100 230]);              % Quick check at the paper's resolution
+% r= results(strcmp({results.kernel},'pdfKnk'));
+% loglog([r.numStates],[r.time],'o');                     % Scaling of pdfKnk with state count
+%
+% The response time and recovery knock reductions given by the learning controller are measured
+% separately, by recovKnk.
+%
+% See also
+% knCtrl knLearn recovKnk simKnk markovMx pdfSpk pdfKnk respT
+
+
+% Check input arguments
+if (nargin<1)||isempty(Deltas), Deltas= [0.1 0.05 0.02 0.01 0.005 0.002 0.001 0.0005]; end;
+if (nargin<2)||isempty(nCycles), nCycles= [100 1000 10000]; end;
+if (nargin<3), fileName= []; end;
+if (nargin<4)||isempty(maxFlops), maxFlops= 1e11; end;
+if (nargin<5)||isempty(maxBytes), maxBytes= 2e9; end;
+limits= [maxFlops maxBytes];
+numRuns= 1000;
+
+% Measured knock probability characteristic (as in markovSim)
+theta0= [-4:2]';
+p0= [0;0;0;0.000998003992015968;0.0109780439121756;0.140718562874252;0.394211576846307];
+
+results= struct('kernel',{},'Delta',{},'numStates',{},'nCycles',{},'numRuns',{},'time',{},...
+                'bytes',{},'outBytes',{},'units',{},'throughput',{},'status',{});
+for Delta= Deltas,
+
+    % Define the state grid, knock probability curve and controller for this resolution
+    theta= [-3.9:Delta:2]';
+    numStates= length(theta);
+    pCurve= interp1(theta0,p0,theta,'PCHIP');
+    pCurve_High= zeros(numStates,1);
+    m1= 1; m2= max(1,round(1.485/Delta));
+    ctl= struct('initialSpark',0,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2);
+    ctlL= ctl; ctlL.learnGain= 1/32; ctlL.cellSpeed= [1:8]; ctlL.cellLoad= [1:8];
+    plant= struct('knockGenTheta',theta,'knockGenP',pCurve);
+    M= []; Madv= []; Mret= []; Pinf= [];
+    held= 3*8*numStates^2;                                      % M, Madv and Mret, once built
+
+    for n= nCycles,
+
+        % Controller step:  scalar, and vectorized over many instances
+        knk= rand(n,numRuns)<0.01;
+        results(end+1)= timeKernel('ctlStep',Delta,numStates,n,1,n,0,...
+                                   @() ctlLoop(ctl,knk(:,1)),1e4*n,limits);
+        results(end+1)= timeKernel('ctlStepVec',Delta,numStates,n,numRuns,n*numRuns,8*numRuns,...
+                                   @() ctlLoop(ctl,knk),20*n*numRuns,limits);
+        results(end+1)= timeKernel('ctlLearnVec',Delta,numStates,n,numRuns,n*numRuns,(8+9*64)*numRuns,...
+                                   @() learnLoop(ctlL,knk),60*n*numRuns,limits);
+
+        % Monte Carlo closed loop simulation
+        results(end+1)= timeKernel('simKnk',Delta,numStates,n,numRuns,n*numRuns,9*(n+1)*numRuns,...
+                                   @() simKnk(n,ctl,plant,numRuns),50*n*numRuns,limits);
+
+        % Markov chain construction and steady state (independent of the horizon)
+        if n==nCycles(1),
+            [r,out]= timeKernel('markovMx',Delta,numStates,NaN,1,numStates,6*8*numStates^2,...
+                                @() markovOut(pCurve,pCurve_High,m1,m2),10*numStates^2,limits);
+            results(end+1)= r;
+            if ~isempty(out), [M,Madv,Mret]= deal(out{:}); end;
+            clear out;
+            [r,Pinf]= timeKernel('ssSolve',Delta,numStates,inf,1,numStates,held+6*8*numStates^2,...
+                                 @() pdfSpk(inf,M,0,theta,pCurve),20*numStates^3,limits,isempty(M));
+            results(end+1)= r;
+            results(end+1)= timeKernel('respT',Delta,numStates,NaN,1,numStates,held+4*8*numStates^2,...
+                                       @() respT(M,sum(Pinf.*theta),theta,pCurve),...
+                                       4*numStates^3,limits,isempty(Pinf));
+        end;
+
+        % Transient propagation and knock event distribution
+        results(end+1)= timeKernel('transient',Delta,numStates,n,1,numStates*(n+1),held+8*numStates*(n+1),...
+                                   @() pdfSpk([0:n],M,0,theta,pCurve),2*n*numStates^2,limits,isempty(M));
+        results(end+1)= timeKernel('pdfKnk',Delta,numStates,n,1,numStates*(n+1),held+3*8*numStates*(n+1),...
+                                   @() pdfKnk(n,Madv,Mret,theta),2*n^2*numStates^2,limits,isempty(M));
+    end;
+end;
+
+% Write the machine readable results, if required
+if isempty(fileName), return; end;
+fid= fopen(fileName,'w');
+if fid<0, error(['Cannot open ' fileName ' for writing']); end;
+fprintf(fid,'kernel,Delta,numStates,nCycles,numRuns,time,bytes,outBytes,units,throughput,status\n');
+for i=1:length(results),
+    r= results(i);
+    fprintf(fid,'%s,%g,%d,%g,%d,%.6g,%.0f,%.0f,%.0f,%.6g,%s\n',r.kernel,r.Delta,r.numStates,r.nCycles,...
+            r.numRuns,r.time,r.bytes,r.outBytes,r.units,r.throughput,r.status);
+end;
+fclose(fid);
+
+
+
+function [r,out]= timeKernel(kernel,Delta,numStates,n,numRuns,units,bytes,fcn,flops,limits,skip)
+
+% Time fcn, (best of up to 3 repeats), unless its estimated cost or memory [maxFlops maxBytes] is too high
+r= struct('kernel',kernel,'Delta',Delta,'numStates',numStates,'nCycles',n,'numRuns',numRuns,...
+          'time',NaN,'bytes',bytes,'outBytes',NaN,'units',units,'throughput',NaN,'status','skipped');
+out= [];
+if (flops>limits(1)) || (bytes>limits(2)) || ((nargin>=11) && skip), return; end;
+t= inf;
+for i=1:3,
+    out= []; tic; out= fcn(); t= min(t,toc);
+    if t*(i+1)>1, break; end;
+end;
+w= whos('out');
+r.time= t;
+r.outBytes= w.bytes;
+r.throughput= units/t;
+r.status= 'ok';
+
+
+function out= markovOut(pCurve,pCurve_High,m1,m2)
+
+% The state transition matrices of markovMx, as one output
+[M,Madv,Mret]= markovMx(pCurve,pCurve_High,m1,m2,m1,m2);
+out= {M,Madv,Mret};
+
+
+function relSpk= ctlLoop(ctl,knk)
+
+% Step the controller(s) through the knock flag time history knk
+relSpk= ctl.initialSpark*ones(1,size(knk,2));
+for i=1:size(knk,1),
+    relSpk= knCtrl(relSpk,knk(i,:),ctl);
+end;
+
+
+function relSpk= learnLoop(ctl,knk)
+
+% Step the learning controller(s) through the knock flag time history knk, changing cell every 100 cycles
+relSpk= ctl.initialSpark*ones(1,size(knk,2));
+learn= [];
+for i=1:size(knk,1),
+    [relSpk,learn]= knLearn(relSpk,knk(i,:),mod(floor(i/100),64)+1,learn,ctl);
+end;
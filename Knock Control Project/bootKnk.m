@@ -0,0 +1,159 @@
+function bs= bootKnk(d,sa,drv,numBoot,seed,alpha,fig)
+
+% bootKnk Bootstrap confidence intervals on the knock control metrics of plotDriver
+%
+% Syntax
+% bs= bootKnk(d,sa)
+% bs= bootKnk(d,sa,drv)
+% bs= bootKnk(d,sa,drv,numBoot)
+% bs= bootKnk(d,sa,drv,numBoot,seed)
+% bs= bootKnk(d,sa,drv,numBoot,seed,alpha)
+% bs= bootKnk(d,sa,drv,numBoot,seed,alpha,fig)
+%
+% Description
+% |bs= bootKnk(d,sa)| propagates the sampling error of the spark sweep |d|, (the cell array of
+% |[numCycles x numCylinders]| knock intensities recorded at spark angles |sa|, as in sweep.mat),
+% to every metric of plotDriver.  Each bootstrap replicate resamples, with replacement, the cycles
+% of each spark angle experiment independently, rebuilds the empirical cdfs, (eCdf), and repeats
+% the whole analysis, (thresholds, knock probability curves, Markov chain steady state and
+% transients, see kpiKnk), so that the replicates show how much the results could differ had
+% another ~1000 cycles been recorded at each spark angle.
+%
+% |bs= bootKnk(d,sa,drv)| specifies the analysis settings |drv|, including the cylinder |drv.cyl|,
+% (see kpiKnk; default plotDriver settings), and |bs= bootKnk(d,sa,drv,numBoot,seed,alpha)|
+% computes |numBoot| replicates, (default 1000), with random number seed |seed|, (default 0), and
+% |100*(1-alpha)|% confidence intervals, (default |alpha= 0.05|).  The replicates are computed in
+% blocks of 25, in parallel (parfor) if a pool is open, and block |b| uses substream |b| of the
+% 'mrg32k3a' stream, so the results do not depend on the number of workers.  Each worker reuses
+% its resampled data arrays, and every replicate reuses the actuated angles and transition
+% structure |drv.lat|.
+%
+% The output structure |bs| has one field for each field of the output |kpi| of kpiKnk, (eg.
+% |bs.ssSpk|, |bs.ssKnock|, |bs.spkTraj|, |bs.T|), each a structure with the fields:
+%   |value|     the metric computed from the original data
+%   |se|        the bootstrap standard error
+%   |lo|, |hi|  the percentile confidence interval
+%   |reps|      the |[numel(value) x numBoot]| replicates
+% and |bs.drv|, the completed settings used, and |bs.numFailed|, the number of failed replicates.
+% Empty metrics, (eg. |pCurve_High| of a single level controller), are omitted.  A replicate fails
+% if the analysis errors, or returns a metric of a different size from the original data, (eg.
+% if a resampled experiment gives a degenerate cdf); its replicates are then NaN, a warning gives
+% the number of failures, and the standard errors and percentiles of each metric are computed
+% over its finite replicates only.
+%
+% |bootKnk(-)| with no left hand arguments, or |bootKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the bootstrap distributions of the steady state mean spark angle and knock probability,
+% and the mean spark angle transients with their confidence intervals.
+%
+% Examples
+% load sweep;
+% bs= bootKnk(d,sa,struct('cyl',1),2000,0,0.05,'Fig');
+% bs.ssSpk.value(1), [bs.ssSpk.lo(1) bs.ssSpk.hi(1)]       % Steady state mean spark and its 95% CI
+% bs.ssKnock.value(1), [bs.ssKnock.lo(1) bs.ssKnock.hi(1)] % ...and mean knock probability
+%
+% See also
+% kpiKnk plotDriver eCdf pairKnk
+
+
+% Check input arguments
+if (nargin<3)||isempty(drv), drv= struct(); end;
+if (nargin<4)||isempty(numBoot), numBoot= 1000; end;
+if (nargin<5)||isempty(seed), seed= 0; end;
+if (nargin<6)||isempty(alpha), alpha= 0.05; end;
+if ~isfield(drv,'cyl') || isempty(drv.cyl), drv.cyl= 1; end;
+cyl= drv.cyl;
+
+% Metrics of the original data, and the settings shared by every replicate
+drv1= drv;
+drv1.cyl= 1;
+[kpi0,drv1]= kpiKnk(eCdf(d,sa,cyl),drv1);
+names= fieldnames(kpi0);
+sz= cellfun(@(f) numel(kpi0.(f)),names);
+numVals= sum(sz);
+
+% Bootstrap replicates, a block at a time
+blockSize= 25;
+numBlocks= ceil(numBoot/blockSize);
+X= cell(1,numBlocks);
+parfor b=1:numBlocks,
+    stream= RandStream('mrg32k3a','Seed',seed);
+    stream.Substream= b;
+    nb= min(blockSize,numBoot-(b-1)*blockSize);
+    Xb= NaN(numVals,nb);
+    dB= cellfun(@(x) zeros(size(x,1),1),d,'UniformOutput',false);
+    for r=1:nb,
+        for i=1:numel(d),
+            m= size(d{i},1);
+            dB{i}(:)= d{i}(randi(stream,m,m,1),cyl);
+        end;
+        try
+            kpi= kpiKnk(eCdf(dB,sa,1),drv1);
+        catch
+            continue;
+        end;
+        v= cellfun(@(f) kpi.(f)(:),names,'UniformOutput',false);
+        if isequal(cellfun(@numel,v),sz), Xb(:,r)= vertcat(v{:}); end;
+    end;
+    X{b}= Xb;
+end;
+X= [X{:}];
+failed= all(isnan(X),1);
+bs.numFailed= sum(failed);
+if bs.numFailed>0,
+    warning('bootKnk:failed','%d of %d bootstrap replicates failed, and are excluded',bs.numFailed,numBoot);
+end;
+
+% Standard errors and percentile confidence intervals, over the finite replicates of each metric
+row= [0; cumsum(sz)];
+for j=1:length(names),
+    if sz(j)==0, continue; end;
+    value= kpi0.(names{j});
+    reps= X(row(j)+1:row(j+1),:);
+    ok= isfinite(reps);
+    m= sum(ok,2);
+    R= reps; R(~ok)= 0;
+    D= bsxfun(@minus,R,sum(R,2)./m); D(~ok)= 0;
+    R(~ok)= NaN;
+    S= sort(R,2);                                           % finite replicates first, in order
+    bs.(names{j}).value= value;
+    bs.(names{j}).se= reshape(sqrt(sum(D.^2,2)./max(m-1,1)),size(value));
+    bs.(names{j}).lo= reshape(pctl(S,m,alpha/2),size(value));
+    bs.(names{j}).hi= reshape(pctl(S,m,1-alpha/2),size(value));
+    bs.(names{j}).reps= reps;
+end;
+drv1.cyl= cyl;
+bs.drv= drv1;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=7) && ~isempty(fig)),
+    figure, hist(bs.ssSpk.reps(1,:),50);
+    xlabel('Steady state mean relative spark angle [deg]');
+    ylabel('Number of replicates');
+
+    figure, hist(bs.ssKnock.reps(1,:),50);
+    xlabel('Steady state mean knock probability [-]');
+    ylabel('Number of replicates');
+
+    figure, plot([0:bs.drv.n(1)],bs.spkTraj.value); hold all;
+    set(gca,'ColorOrderIndex',1);
+    plot([0:bs.drv.n(1)],bs.spkTraj.lo,':');
+    set(gca,'ColorOrderIndex',1);
+    plot([0:bs.drv.n(1)],bs.spkTraj.hi,':');
+    xlabel('Cycle number [-]');
+    ylabel('Mean relative spark angle [deg]');
+end;
+
+
+
+function q= pctl(S,m,f)
+
+% Percentile f (0..1) of the first m(i) replicates of each row i of the row-sorted replicates S,
+% by linear interpolation, (NaN if m(i) is zero)
+numRows= size(S,1);
+k= 1 + f*(max(m,1)-1);
+k0= floor(k);
+k1= min(k0+1,max(m,1));
+i= [1:numRows]';
+q= S(i+numRows*(k0-1)) + (k-k0).*(S(i+numRows*(k1-1))-S(i+numRows*(k0-1)));
+q(m==0)= NaN;
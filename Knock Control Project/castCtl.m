@@ -0,0 +1,62 @@
+function [ctlT,scale]= castCtl(ctl,type,q)
+
+% castCtl Cast knock controller parameters to a fixed-point or single precision data type
+%
+% Syntax
+% [ctlT,scale]= castCtl(ctl,type)
+% [ctlT,scale]= castCtl(ctl,type,q)
+%
+% Description
+% |[ctlT,scale]= castCtl(ctl,type)| returns the controller parameter structure |ctl|, (see knCtrl),
+% with every field converted to the data type |type|, one of |'double'|, |'single'|, |'int32'| or
+% |'int16'|.  knCtrl and simKnk are written so that the whole controller step is then carried out
+% in that type, with saturating integer arithmetic for the integer types, as on an ECU.
+%
+% For the integer types, angles are represented in Q-format, ie. as integer multiples of 
+% |2^-q| degrees, and |scale= 2^q| converts between the two:  |angle[deg]= double(x)/scale|.  The 
+% default is |q= 8| for |'int16'|, (a range of +/-128 deg with a resolution of 0.0039 deg), and 
+% |q= 16| for |'int32'|.  For the floating point types |scale= 1|.  Gains that are not exact 
+% multiples of |2^-q| are rounded to the nearest, which changes the effective m1/m2 ratio and hence
+% the closed-loop knock rate - see driftCtl.
+%
+% The learning parameters of knLearn, |learnGain|, |cellSpeed| and |cellLoad|, and the intensity
+% thresholds |Tx| and |Tx_High|, are not angles and are left unchanged, (whereas |learnMargin| is
+% converted like the other angles).
+%
+% Examples
+% [ctl16,scale]= castCtl(ctl,'int16',8);
+% relSpk= knCtrl(ctl16.initialSpark*ones(1000,1,'int16'),rand(1000,1)<0.01,ctl16);
+% relSpkDeg= double(relSpk)/scale;
+%
+% See also
+% knCtrl simKnk driftCtl
+
+
+% Check input arguments
+if (nargin<3)||isempty(q),
+    switch type,
+        case 'int16', q= 8;
+        case 'int32', q= 16;
+        otherwise,    q= 0;
+    end;
+end;
+if ~isfield(ctl,'spkMin'), ctl.spkMin= -3; end;
+if ~isfield(ctl,'spkMax'), ctl.spkMax= 2; end;
+
+% Convert each parameter
+switch type,
+    case {'double','single'},
+        scale= 1;
+        f= @(x) cast(x,type);
+    case {'int16','int32'},
+        scale= 2^q;
+        f= @(x) cast(round(x*scale),type);
+    otherwise,
+        error('Input parameter type should be ''double'', ''single'', ''int32'' or ''int16''');
+end;
+ctlT= ctl;
+names= fieldnames(ctl);
+for i=1:length(names),
+    if any(strcmp(names{i},{'learnGain','cellSpeed','cellLoad','Tx','Tx_High'})), continue; end;
+    ctlT.(names{i})= f(ctl.(names{i}));
+end;
@@ -1,11 +1,20 @@
-function [pdf1,pdfPoints1]=compress(pdf,pdfPoints)
+function [pdf1,pdfPoints1,binMap]=compress(pdf,pdfPoints)
 
 % Deals with repeated values in pdfPoints and hence in pdf
-[pdfPoints1,~,i2]= unique(pdfPoints);
-if length(pdfPoints1)==length(pdfPoints),
-    pdf1= pdf;
+%
+% |[pdf1,pdfPoints1]=compress(pdf,pdfPoints)| sums the rows of the [numStates x numCols] matrix
+% |pdf| that share the same value in |pdfPoints|, returning the unique sorted values |pdfPoints1|.
+% The states are mapped to bins once, into a sparse [numBins x numStates] aggregation operator,
+% so that the whole matrix is then reduced in a single pass, in time linear in the number of
+% states x columns.
+%
+% |[pdf1,pdfPoints1,binMap]=compress(pdf,pdfPoints)| also returns the bin map, and
+% |[pdf1,pdfPoints1]=compress(pdf,binMap)| reuses it, eg. for every cycle block of a transient.
+if isstruct(pdfPoints),
+    binMap= pdfPoints;
 else
-    for i=1:length(pdfPoints1),
-        pdf1(i,:)= sum(pdf(i2==i,:),1);
-    end;
+    [binMap.points,~,i2]= unique(pdfPoints);
+    binMap.S= sparse(i2(:),[1:length(i2)]',1,length(binMap.points),length(i2));
 end;
+pdfPoints1= binMap.points;
+pdf1= full(binMap.S*pdf);
@@ -0,0 +1,96 @@
+function [tbl,res]= cylKnk(d,sa,drv,cyls,fig)
+
+% cylKnk Knock control analysis of plotDriver for every cylinder of an engine
+%
+% Syntax
+% [tbl,res]= cylKnk(d,sa)
+% [tbl,res]= cylKnk(d,sa,drv)
+% [tbl,res]= cylKnk(d,sa,drv,cyls)
+% [tbl,res]= cylKnk(d,sa,drv,cyls,fig)
+%
+% Description
+% |[tbl,res]= cylKnk(d,sa)| runs the whole analysis of plotDriver, (the borderline thresholds,
+% knock probability curves, transition structure, steady state, transients, pdfKnk and respT,
+% see kpiKnk), for every cylinder of the spark sweep |d|, (the cell array of |[numCycles x
+% numCylinders]| knock intensities recorded at spark angles |sa|, as in sweep.mat), in one call,
+% rather than for |cyl= 1| only.  The empirical cdfs of all cylinders are computed once, (eCdf),
+% and the actuated angles and advance / retard structure, which do not depend on the cylinder,
+% are built once and shared, (|drv.lat|).  The cylinders are then analyzed in parallel (parfor)
+% if a pool is open.
+%
+% |[tbl,res]= cylKnk(d,sa,drv,cyls)| specifies the analysis settings |drv|, (see kpiKnk; default
+% plotDriver settings), and the cylinders |cyls|, (default all).
+%
+% Output |tbl| is a table with one row per cylinder and the variables:
+%   |Cyl|       the cylinder number
+%   |Tx|        the knock threshold(s)
+%   |ssSpk|     the steady state mean and standard deviation of spark angle
+%   |ssKnock|   the steady state mean and standard deviation of knock probability
+%   |spkN|      the ensemble mean spark angle after |n(1)| cycles, from each of |myAngles|
+%   |mSpk|      the mean spark angle time-averaged over the first |n(1)| cycles, from each of |myAngles|
+%   |mKnk|      the expected number of knock events in the first |n(1)| cycles, from each of |myAngles|
+%   |knkN|      the mean and standard deviation of the number of knock events in the first |n(2)|
+%               cycles, from the first of |myAngles|, (see pdfKnk)
+%   |T|, |nk|   the expected response time, and number of knock events, to the steady state mean
+%               spark angle from each of |myAngles|, (see respT)
+% and |res| is the structure array of the full results of each cylinder, (see kpiKnk).
+%
+% |cylKnk(-)| with no left hand arguments, or |cylKnk(-,'Fig')| with specified input |'Fig'|, plots
+% the knock probability curves and the steady state mean spark angle of every cylinder.
+%
+% Examples
+% load sweep;
+% [tbl,res]= cylKnk(d,sa,struct('BLindx',5),[1:6],'Fig');
+% tbl(:,{'Cyl','ssSpk','ssKnock'})                         % Steady state of every cylinder
+%
+% See also
+% kpiKnk bootKnk plotDriver eCdf
+
+
+% Check input arguments
+if (nargin<3)||isempty(drv), drv= struct(); end;
+if (nargin<4)||isempty(cyls), cyls= [1:size(d{1},2)]; end;
+numCyl= length(cyls);
+
+% Work common to every cylinder: the cdfs, and the actuated angles and transition structure
+myCdf= eCdf(d,sa,cyls);
+[~,drv]= kpiKnk([],drv);
+
+% Analyze each cylinder
+res= cell(numCyl,1);
+parfor c=1:numCyl,
+    drvc= drv;
+    drvc.cyl= c;
+    res{c}= kpiKnk(myCdf,drvc);
+end;
+res= [res{:}]';
+
+% Per cylinder result table, with the transient and response time results at each of myAngles
+theta1= drv.lat.theta1;
+for j=1:length(drv.myAngles), myIndexes(j)= find(theta1>=drv.myAngles(j),1,'first'); end;
+k= [0:drv.n(2)]';
+Cyl= cyls(:);
+Tx= vertcat(res.Tx);
+ssSpk= vertcat(res.ssSpk);
+ssKnock= vertcat(res.ssKnock);
+spkN= cell2mat(arrayfun(@(r) r.spkTraj(end,:),res,'UniformOutput',false));
+mSpkN= cell2mat(arrayfun(@(r) r.mSpk(:,end)',res,'UniformOutput',false));
+mKnkN= cell2mat(arrayfun(@(r) r.mKnk(:,end)',res,'UniformOutput',false));
+knkN= cell2mat(arrayfun(@(r) [r.Pnk(1,:)*k, sqrt(max(r.Pnk(1,:)*k.^2-(r.Pnk(1,:)*k)^2,0))],res,'UniformOutput',false));
+T= cell2mat(arrayfun(@(r) r.T(myIndexes)',res,'UniformOutput',false));
+nk= cell2mat(arrayfun(@(r) r.nk(myIndexes)',res,'UniformOutput',false));
+tbl= table(Cyl,Tx,ssSpk,ssKnock,spkN,mSpkN,mKnkN,knkN,T,nk,...
+           'VariableNames',{'Cyl','Tx','ssSpk','ssKnock','spkN','mSpk','mKnk','knkN','T','nk'});
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=5) && ~isempty(fig)),
+    figure, plot(theta1,[res.pCurve]);
+    xlabel('Relative spark angle [deg]');
+    ylabel('Knock probability');
+    legend(arrayfun(@(c) ['Cyl #' num2str(c)],cyls,'UniformOutput',false));
+
+    figure, bar(Cyl,ssSpk(:,1));
+    xlabel('Cylinder');
+    ylabel('Steady state mean relative spark angle [deg]');
+end;
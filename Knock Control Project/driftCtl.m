@@ -0,0 +1,110 @@
+function drift= driftCtl(n,ctl,plant,types,numRuns,tol,fig)
+
+% driftCtl Accuracy of fixed-point and single precision knock controller variants
+%
+% Syntax
+% drift= driftCtl(n,ctl,plant)
+% drift= driftCtl(n,ctl,plant,types)
+% drift= driftCtl(n,ctl,plant,types,numRuns)
+% drift= driftCtl(n,ctl,plant,types,numRuns,tol)
+% drift= driftCtl(n,ctl,plant,types,numRuns,tol,fig)
+%
+% Description
+% |drift= driftCtl(n,ctl,plant)| compares |n| cycle closed-loop simulations of the knock controller
+% |ctl| and plant |plant|, (see simKnk), carried out in each of the data types in the cell array
+% |types|, (default |{'double','single','int32','int16'}|, see castCtl), against the double 
+% precision reference.  The output structure array |drift| has one element per type, with fields:
+%   |type|, |scale|      the data type and its Q-format scale, (see castCtl)
+%   |openLoopErr|        the maximum spark angle error [deg] when the typed controller is driven
+%                        by the same knock flags, (or two level knock levels), as the reference,
+%                        ie. the pure arithmetic drift
+%   |meanSpkErr|         the difference [deg] in closed-loop time-averaged mean spark angle
+%   |knockRateErr|       the difference in closed-loop knock rate
+%   |stdErr|             the standard error [deg] of |meanSpkErr|
+%   |bytes|              the storage of one spark angle state in the type
+%   |throughput|         controller steps per second of knCtrl in MATLAB, vectorized over |numRuns|
+%                        instances, for information only:  the MATLAB host timing of the integer
+%                        types says nothing about the fixed-point step on the target
+% All closed-loop runs use the same random numbers, so that the differences are due to the data
+% type alone.  |drift(1).best| is the name of the narrowest type whose |openLoopErr| and
+% |meanSpkErr| are both within |tol| degrees, (default |tol= 0.01|), the most accurate of these if
+% several have the same width.  It is selected on accuracy and storage only, not on |throughput|.
+% The default |numRuns| is 1000.
+%
+% |driftCtl(-)| with no left hand arguments, or |driftCtl(-,'Fig')| with specified input |'Fig'|, 
+% plots the open-loop spark error of each type against cycle number.
+%
+% Examples
+% ctl= struct('initialSpark',0,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2);
+% plant= struct('knockGenTheta',theta,'knockGenP',myPcurve1);
+% drift= driftCtl(10000,ctl,plant,[],1000,0.01,'Fig');
+% drift(1).best
+%
+% See also
+% castCtl knCtrl simKnk benchKnk
+
+
+% Check input arguments
+if (nargin<4)||isempty(types), types= {'double','single','int32','int16'}; end;
+if (nargin<5)||isempty(numRuns), numRuns= 1000; end;
+if (nargin<6)||isempty(tol), tol= 0.01; end;
+seed= 1;
+
+% Double precision reference
+[refSpark,refKnk]= simKnk(n,ctl,plant,numRuns,seed);
+refMean= mean(refSpark(2:end,:),1);
+refRate= mean(refKnk(1:n,:)>0,1);
+
+for i=1:length(types),
+    [ctlT,scale]= castCtl(ctl,types{i});
+    drift(i).type= types{i};
+    drift(i).scale= scale;
+
+    % Open loop:  replay the reference knock flags, (or levels), through the typed controller law
+    ctlR= rmfield(ctlT,intersect(fieldnames(ctlT),{'Tx','Tx_High'}));
+    relSpk= ctlT.initialSpark*ones(numRuns,1,types{i});
+    relSpk= min(max(relSpk,ctlT.spkMin),ctlT.spkMax);
+    err= zeros(n,1);
+    for j=1:n,
+        relSpk= knCtrl(relSpk,refKnk(j,:)',ctlR);
+        err(j)= max(abs(double(relSpk)/scale - refSpark(j+1,:)'));
+    end;
+    drift(i).openLoopErr= max(err);
+    drift(i).errHistory= err;
+
+    % Storage, and (host) controller throughput
+    b= zeros(1,1,types{i});
+    w= whos('b');
+    drift(i).bytes= w.bytes;
+    tic;
+    for j=1:n, relSpk= knCtrl(relSpk,refKnk(j,:)',ctlR); end;
+    drift(i).throughput= n*numRuns/toc;
+
+    % Closed loop with common random numbers
+    plantT= plant;
+    plantT.knockGenTheta= plant.knockGenTheta*scale;
+    [relSpark,knocking]= simKnk(n,ctlT,plantT,numRuns,seed);
+    d= mean(relSpark(2:end,:),1)/scale - refMean;
+    drift(i).meanSpkErr= mean(d);
+    drift(i).stdErr= std(d)/sqrt(numRuns);
+    drift(i).knockRateErr= mean(mean(knocking(1:n,:)>0,1) - refRate);
+end;
+
+% Select the narrowest type that is accurate enough, (the reference if none is)
+ok= find(([drift.openLoopErr]<=tol) & (abs([drift.meanSpkErr])<=tol));
+best= 'double';
+if ~isempty(ok),
+    [~,j]= sortrows([[drift(ok).bytes]' [drift(ok).openLoopErr]']);
+    best= drift(ok(j(1))).type;
+end;
+[drift.best]= deal(best);
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=7) && ~isempty(fig)),
+    figure, 
+    for i=1:length(drift), semilogy([1:n],max(drift(i).errHistory,eps)); hold all; end;
+    xlabel('Cycle number [-]');
+    ylabel('Open-loop spark error [deg]');
+    legend(types);
+end;
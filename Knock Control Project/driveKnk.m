@@ -0,0 +1,104 @@
+function [spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0,opRes,fig)
+
+% driveKnk Time-inhomogeneous Markov chain analysis of a knock controller over a drive cycle
+%
+% Syntax
+% [spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0)
+% [spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0,opRes)
+% [spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0,opRes,fig)
+%
+% Description
+% |[spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0)| propagates the closed loop
+% spark angle pdf of a traditional knock controller through a drive cycle, in which the operating
+% point changes every cycle according to the speed and load traces |speed| and |engLoad|.  The
+% knock probability at each controller state |theta| is looked up from the operating point map
+% |map|, (see opMap and opKnockP), and |gains= [m1 m2]| or |[m1 m2 m1_High m2_High]| are the
+% controller steps as in markovMx, (the high intensity knock probability being taken from the
+% second threshold of the map, if present).  |P0| is the initial spark angle, or initial pdf.
+%
+% The state transition matrix of each distinct operating point in the trace is constructed only
+% once, as a sparse matrix sharing the (operating point independent) advance and retard structure
+% of markovMx, and is reused whenever that operating point recurs, so that the cost of each
+% cycle is a single sparse matrix-vector product.
+%
+% Outputs |spkStats| and |pStats| are |[2 x (n+1)]| matrices of the ensemble mean and standard
+% deviation of the spark angle and of the instantaneous knock probability at cycles |[0:n]|, as
+% in pdfSpk, where |n= length(speed)|.  The expected number of knock events in the first |k|
+% cycles is therefore |sum(pStats(1,1:k))|.  Output |Pn| is the final spark angle pdf.
+%
+% |[spkStats,pStats,Pn]= driveKnk(map,speed,engLoad,theta,gains,P0,opRes)| first rounds the speed
+% and load traces to the resolutions |opRes= [speedRes loadRes]|, which bounds the number of
+% distinct operating points, (and hence of cached matrices), for measured drive traces.
+%
+% |driveKnk(-)| with no left hand arguments, or |driveKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the mean spark angle and mean knock probability over the drive cycle.
+%
+% Examples
+% map= opMap(sweeps,theta,1,[0.99 0.995]);
+% [spkStats,pStats]= driveKnk(map,speedTrace,loadTrace,theta,[1 99 4 150],0,[10 0.01],'Fig');
+% simPlant= struct('map',map,'speed',speedTrace,'load',loadTrace);     % ...and the matching
+% [relSpark,knocking]= simKnk(length(speedTrace),ctl,simPlant,1000);    %    Monte Carlo simulation
+%
+% See also
+% opMap opKnockP markovMx pdfSpk simKnk
+
+
+% Check input arguments
+if length(gains)<4, gains(3:4)= gains(1:2); end;
+if (nargin>=7) && ~isempty(opRes),
+    speed= round(speed/opRes(1))*opRes(1);
+    engLoad= round(engLoad/opRes(2))*opRes(2);
+end;
+theta= theta(:);
+numStates= length(theta);
+n= length(speed);
+if length(P0)==1,
+    myIndex= find(theta>=P0,1,'first');
+    P0= zeros(numStates,1); P0(myIndex)=1;
+end;
+
+% Operating point independent advance / retard structure, (as markovMx, indexed from zero)
+imax= numStates-1;
+i= [0:imax]';
+advIndx= i + min(gains(1),imax-i) + 1;
+retIndx= i - min(gains(2),i) + 1;
+retIndx_High= i - min(gains(4),i) + 1;
+hasHigh= size(map.pCurve,4)>1;
+
+% Distinct operating points, and their knock probability curves and (transposed) matrices
+[ops,~,opIndx]= unique([speed(:) engLoad(:)],'rows');
+numOps= size(ops,1);
+pCurves= zeros(numStates,numOps);
+Mt= cell(numOps,1);
+for j=1:numOps,
+    p= opKnockP(map,ops(j,1),ops(j,2),theta);
+    pH= zeros(numStates,1);
+    if hasHigh, pH= opKnockP(map,ops(j,1),ops(j,2),theta,2); end;
+    pCurves(:,j)= p;
+    Mt{j}= sparse([advIndx; retIndx; retIndx_High],[i; i; i]+1,[1-p; p-pH; pH],numStates,numStates);
+end;
+
+% Propagate the pdf through the drive cycle
+spkStats= zeros(2,n+1);
+pStats= zeros(2,n+1);
+Pn= P0;
+for k=0:n,
+    j= opIndx(min(k+1,n));
+    spkStats(:,k+1)= [theta'*Pn; theta.^2'*Pn];
+    pStats(:,k+1)= [pCurves(:,j)'*Pn; (pCurves(:,j).^2)'*Pn];
+    if k<n, Pn= Mt{j}*Pn; end;
+end;
+spkStats(2,:)= sqrt(max(spkStats(2,:)-spkStats(1,:).^2,0));
+pStats(2,:)= sqrt(max(pStats(2,:)-pStats(1,:).^2,0));
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=8) && ~isempty(fig)),
+    figure, plot([0:n],spkStats(1,:));
+    xlabel('Cycle number [-]');
+    ylabel('Mean relative spark angle [deg]');
+
+    figure, plot([0:n],pStats(1,:));
+    xlabel('Cycle number [-]');
+    ylabel('Mean knock probability [-]');
+end;
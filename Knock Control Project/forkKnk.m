@@ -0,0 +1,47 @@
+function simState1= forkKnk(simState,runs,numForks,seed)
+
+% forkKnk Branch many Monte Carlo continuations from a knock control simulation state
+%
+% Syntax
+% simState1= forkKnk(simState,runs,numForks,seed)
+%
+% Description
+% |simState1= forkKnk(simState,runs,numForks,seed)| returns a new simulation state, (see simKnk), 
+% containing |numForks| copies of the controller and engine delay state of each of the runs 
+% |runs| of |simState|, (or of all runs if |runs| is empty), at the same cycle.  The copies share 
+% their state up to this cycle but are given a new random number stream with the specified |seed|, 
+% so that continuing |simState1| with simKnk simulates |length(runs)*numForks| statistically
+% independent futures, without re-simulating the warm-up.  The field |simState1.parentRun| gives 
+% the run of |simState| from which each continuation was forked.
+%
+% The returned state may be modified before continuing, eg. to study the recovery from a 
+% disturbance applied at the fork cycle.
+%
+% Examples
+% [~,~,simState]= simKnk(2000,ctl,plant,1,1);          % Warm up a single run to steady state
+% fork= forkKnk(simState,1,10000,2);                    % 10^4 continuations from cycle 2000
+% fork.relSpk= fork.relSpk + 1;                         % ...after a +1 deg disturbance
+% [relSpark,knocking]= simKnk(250,ctl,plant,fork);
+% plot([0:250],mean(relSpark,2));                       % Mean recovery
+%
+% See also
+% simKnk snapKnk
+
+
+% Check input arguments
+if isempty(runs), runs= [1:length(simState.relSpk)]; end;
+parentRun= reshape(repmat(runs(:)',numForks,1),[],1);
+
+% Replicate the controller and engine delay states, with a new random number stream
+stream= RandStream('mrg32k3a','Seed',seed);
+simState1= simState;
+simState1.seed= seed;
+simState1.relSpk= simState.relSpk(parentRun);
+simState1.knocking= simState.knocking(parentRun);
+if isfield(simState,'learn') && ~isempty(simState.learn),      % learned offsets, (see knLearn)
+    simState1.learn.cell= simState.learn.cell(parentRun);
+    simState1.learn.offset= simState.learn.offset(:,parentRun);
+    simState1.learn.valid= simState.learn.valid(:,parentRun);
+end;
+simState1.rngState= stream.State;
+simState1.parentRun= parentRun;
@@ -0,0 +1,51 @@
+function relSpk= knCtrl(relSpk,knocking,ctl)
+
+% knCtrl Traditional knock controller step, vectorized over many controller instances
+%
+% Syntax
+% relSpk= knCtrl(relSpk,knocking,ctl)
+%
+% Description
+% |relSpk= knCtrl(relSpk,knocking,ctl)| applies one step of the knock0 'Knock Control' law to the
+% relative spark angles |relSpk| of any number of controller instances, given the corresponding
+% knock flags |knocking|.  Each instance is retarded by |ctl.retardGain| if it knocked, is otherwise
+% advanced by |ctl.advanceGain|, and is then saturated to the range |[ctl.spkMin, ctl.spkMax]|,
+% exactly as in the knCtrl chart of knock0.mdl (and sf_gateway_c2_knock0).
+%
+% The controller parameters are given by the structure |ctl|, with fields |initialSpark|,
+% |retardGain|, |advanceGain|, |spkMin| and |spkMax|, named as in the knock0 'Knock Control' mask.
+% If |knocking| is a knock level |0,1,2| rather than a boolean, level 2 (high intensity) knock 
+% events are retarded by |ctl.retardGain_High| instead.
+%
+% The knock flags may be logical, or numeric 0/1 values, (eg. the knock0 |yout| signal).  If the
+% knock threshold |ctl.Tx| is given, |knocking| is instead a knock intensity, and is first
+% thresholded with |ctl.Tx| to give the knock flag, or, if |ctl.Tx_High| is also given, with both
+% thresholds to give the knock level, (level 2 when the intensity exceeds |ctl.Tx_High|).
+%
+% Examples
+% ctl= struct('initialSpark',-1.6,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2);
+% relSpk= knCtrl(ctl.initialSpark*ones(1000,1),rand(1000,1)<0.01,ctl);
+%
+% See also
+% simKnk markovMx
+
+
+% Threshold knock intensities
+if isfield(ctl,'Tx'),
+    if isfield(ctl,'Tx_High'), knocking= uint8(knocking>ctl.Tx) + uint8(knocking>ctl.Tx_High);
+    else knocking= knocking>ctl.Tx;
+    end;
+end;
+
+% Traditional knock control
+if islogical(knocking),
+    relSpk(knocking)= relSpk(knocking) - ctl.retardGain;
+    relSpk(~knocking)= relSpk(~knocking) + ctl.advanceGain;
+else
+    relSpk(knocking==1)= relSpk(knocking==1) - ctl.retardGain;
+    relSpk(knocking==2)= relSpk(knocking==2) - ctl.retardGain_High;
+    relSpk(knocking==0)= relSpk(knocking==0) + ctl.advanceGain;
+end;
+
+% Apply saturation limits
+relSpk= min(max(relSpk,ctl.spkMin),ctl.spkMax);
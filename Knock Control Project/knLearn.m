@@ -0,0 +1,66 @@
+function [relSpk,learn]= knLearn(relSpk,knocking,opCell,learn,ctl)
+
+% knLearn Adaptive (borderline learning) knock controller step, vectorized over many controller instances
+%
+% Syntax
+% [relSpk,learn]= knLearn(relSpk,knocking,opCell,learn,ctl)
+%
+% Description
+% |[relSpk,learn]= knLearn(relSpk,knocking,opCell,learn,ctl)| applies one step of the traditional
+% knock control law, (see knCtrl), to the relative spark angles |relSpk| of any number of
+% controller instances, and additionally learns the borderline spark angle of each speed/load
+% operating point cell.  |opCell| is the current cell index of each instance, (or a scalar if all
+% instances share the same operating point), and |learn| is the learning state, which should be
+% empty |[]| on the first step.
+%
+% While an instance remains in a cell, the learned offset of that cell tracks its (sawtooth)
+% spark angle with the exponentially weighted moving average gain |ctl.learnGain|, so that it
+% converges to the mean borderline spark angle of the cell.  When the instance enters a cell
+% that it has visited before, its spark angle is restored to the learned offset of that cell, less
+% a safety margin |ctl.learnMargin|, (default 0), before the knock control step, instead of
+% re-converging from the spark angle of the previous cell.  The number of cells is
+% |numel(ctl.cellSpeed)*numel(ctl.cellLoad)|, and the work per step is independent of the number
+% of cells.
+%
+% The learning state |learn| has fields |cell| (the current cell of each instance), |offset| and
+% |valid|, (the learned offsets and whether they have been learned, both |[numCells x numRuns]|).
+% The offsets are held in the data type of |relSpk|, (see castCtl).
+%
+% Examples
+% ctl= struct('initialSpark',-1.6,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2,...
+%             'learnGain',1/32,'learnMargin',0,'cellSpeed',[1000:1000:6000],'cellLoad',[0.2:0.2:1]);
+% learn= [];
+% [relSpk,learn]= knLearn(ctl.initialSpark*ones(1000,1),rand(1000,1)<0.01,7,learn,ctl);
+%
+% See also
+% knCtrl simKnk recovKnk
+
+
+% Check input arguments
+if ~isfield(ctl,'learnMargin'), ctl.learnMargin= 0; end;
+sz= size(relSpk);
+relSpk= relSpk(:);
+numRuns= length(relSpk);
+if isempty(learn),
+    numCells= numel(ctl.cellSpeed)*numel(ctl.cellLoad);
+    learn.cell= zeros(numRuns,1);
+    learn.offset= zeros(numCells,numRuns,class(relSpk));
+    learn.valid= false(numCells,numRuns);
+end;
+if isscalar(opCell), opCell= opCell*ones(numRuns,1); end;
+j= opCell(:) + size(learn.offset,1)*[0:numRuns-1]';
+
+% Restore the learned offset on entry to a previously visited cell
+enter= (opCell(:)~=learn.cell) & learn.valid(j);
+relSpk(enter)= learn.offset(j(enter)) - ctl.learnMargin;
+learn.cell= opCell(:);
+
+% Traditional knock control
+relSpk= knCtrl(relSpk,knocking(:),ctl);
+
+% Update the learned offset of the current cell
+k= learn.valid(j);
+learn.offset(j(~k))= relSpk(~k);
+learn.offset(j(k))= learn.offset(j(k)) + ctl.learnGain*(relSpk(k)-learn.offset(j(k)));
+learn.valid(j)= true;
+relSpk= reshape(relSpk,sz);
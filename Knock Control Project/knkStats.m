@@ -0,0 +1,134 @@
+function st= knkStats(tr,win,maxGap,fig)
+
+% knkStats Knock counts, sliding window counts, bursts and inter-knock intervals of a packed knock trace
+%
+% Syntax
+% st= knkStats(tr)
+% st= knkStats(tr,win)
+% st= knkStats(tr,win,maxGap)
+% st= knkStats(tr,win,maxGap,fig)
+%
+% Description
+% |st= knkStats(tr,win)| analyses the bit-packed knock trace |tr|, (see knkTrace), and returns the
+% structure |st| with the fields:
+%   |count|         the number of knock events in each run, |[1 x numRuns]|
+%   |maxWin|        the largest number of knock events in any |win| consecutive cycles of each run
+%   |winHist|       |winHist(k+1)| is the number of |win| cycle windows, (at every cycle offset, in
+%                   all runs), containing exactly |k| knock events, |[(win+1) x 1]|
+%   |longestBurst|  the longest run of consecutive knock events in each run, |[1 x numRuns]|
+%   |gapHist|       |gapHist(d)| is the number of pairs of successive knock events |d| cycles
+%                   apart, pooled over all runs, with |d>=maxGap| counted in the last bin
+% The default window is |win= 100| cycles, and the default |maxGap= 1000|.
+%
+% The statistics are computed from the packed words, without unpacking the trace to logical
+% arrays.  The knock counts are the popcounts of the words, (see popCount).  The window counts
+% are differences of the running popcount at each cycle, ie. the popcount of the word span
+% between the two window edges plus the masked popcounts of the partial words at the edges, which
+% are looked up a byte at a time.  The burst start and end cycles are the bits of |w & ~(w<<1)|
+% and |w & ~(w>>1)|, (with the carry between successive words), and only the few words containing
+% a burst boundary are searched for their bit positions, from which the burst lengths and the
+% intervals between bursts follow.  All statistics are computed a block of runs at a time, so
+% that the memory used is bounded independently of the size of the trace.  The running popcount,
+% (one value per cycle, since every window offset is counted), dominates the memory and time.
+%
+% |knkStats(-)| with no left hand arguments, or |knkStats(-,'Fig')| with specified input |'Fig'|,
+% plots the sliding window count and inter-knock interval distributions.
+%
+% Examples
+% tr= knkTrace(knocking(1:end-1,:));
+% st= knkStats(tr,100,[],'Fig');
+% P= sum(st.winHist(4:end))/sum(st.winHist);   % P(more than 2 knocks in a 100 cycle window)
+%
+% See also
+% knkTrace popCount pdfKnk rareKnk
+
+
+% Check input arguments
+if (nargin<2)||isempty(win), win= 100; end;
+if (nargin<3)||isempty(maxGap), maxGap= 1000; end;
+n= tr.numCycles;
+numRuns= tr.numRuns;
+win= min(win,n);
+
+% Knock counts, sliding windows, bursts and intervals, a block of runs at a time
+st.count= zeros(1,numRuns);
+st.maxWin= zeros(1,numRuns);
+st.winHist= zeros(win+1,1);
+st.longestBurst= zeros(1,numRuns);
+st.gapHist= zeros(maxGap,1);
+numWords= size(tr.words,1);
+blk= max(1,floor(2^23/(64*numWords+1)));
+for r0=1:blk:numRuns,
+    r= r0:min(r0+blk-1,numRuns);
+    words= tr.words(:,r);
+    st.count(r)= sum(popCount(words),1);
+
+    % Sliding window counts, from the running popcount of the masked words
+    P= runCount(words);
+    P= [zeros(1,length(r)); P(1:n,:)];
+    W= P(win+1:end,:) - P(1:end-win,:);
+    st.maxWin(r)= max(W,[],1);
+    st.winHist= st.winHist + accumarray(W(:)+1,1,[win+1 1]);
+
+    % Burst start and end cycles, from the run boundaries of the words
+    carry= [zeros(1,length(r),'uint64'); bitshift(words(1:end-1,:),-63)];
+    first= bitand(words,bitcmp(bitor(bitshift(words,1),carry)));
+    carry= [bitshift(words(2:end,:),63); zeros(1,length(r),'uint64')];
+    last= bitand(words,bitcmp(bitor(bitshift(words,-1),carry)));
+    [s,j]= setBits(first);
+    e= setBits(last);
+    L= e - s + 1;
+    if ~isempty(L),
+        st.longestBurst(r)= accumarray(j,L,[length(r) 1],@max)';
+    end;
+
+    % Inter-knock intervals:  one cycle within each burst, and the gaps between bursts
+    d= s(2:end) - e(1:end-1);
+    d= d(diff(j)==0);
+    st.gapHist(1)= st.gapHist(1) + sum(L-1);
+    st.gapHist= st.gapHist + accumarray(min(d,maxGap),1,[maxGap 1]);
+end;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=4) && ~isempty(fig)),
+    figure, bar([0:win],st.winHist/sum(st.winHist));
+    xlabel(['Number of knock events in ' num2str(win) ' cycles']);
+    ylabel('Probability');
+
+    figure, semilogy([1:maxGap],st.gapHist/max(1,sum(st.gapHist)));
+    xlabel('Inter-knock interval [cycles]');
+    ylabel('Probability');
+end;
+
+
+
+function P= runCount(words)
+
+% Number of set bits in each word up to and including each bit, (cycle), by byte table look-up
+persistent pre
+if isempty(pre), pre= cumsum(fliplr(dec2bin(0:255,8)=='1'),2); end;
+[numWords,numRuns]= size(words);
+v= reshape(double(typecast(words(:),'uint8'))+1,8,[]);              % bytes, least significant first
+full= reshape(pre(v,8),8,[]);
+below= cumsum([zeros(1,size(full,2)); full(1:7,:)],1);               % set bits in the lower bytes
+C= cumsum(reshape(sum(full,1),numWords,numRuns),1);
+below= bsxfun(@plus,below,reshape([zeros(1,numRuns); C(1:end-1,:)],1,[]));   % ...and the lower words
+P= zeros(8,8,numWords*numRuns);
+for b=1:8,
+    P(b,:,:)= reshape(below + reshape(pre(v,b),8,[]),[1 8 numWords*numRuns]);
+end;
+P= reshape(P,64*numWords,numRuns);
+
+
+function [c,r]= setBits(words)
+
+% Cycle and run of the set bits of sparse packed words, in order of run and then cycle
+[w,r]= find(words);
+w= w(:); r= r(:);
+v= words(w + size(words,1)*(r-1));
+B= false(64,length(v));
+for b=1:64, B(b,:)= bitget(v,b)'; end;
+[b,k]= find(B);
+c= 64*(w(k)-1) + b;
+r= r(k);
@@ -0,0 +1,99 @@
+function out= knkTrace(in,arg2)
+
+% knkTrace Bit-packed knock event trace
+%
+% Syntax
+% tr= knkTrace(knocking)
+% tr= knkTrace(knocking,tr)
+% knocking= knkTrace(tr)
+% knocking= knkTrace(tr,cycles)
+%
+% Description
+% |tr= knkTrace(knocking)| packs the |[numCycles x numRuns]| knock flags |knocking|, (eg. from simKnk,
+% or the |knocking| output logged by knock0.mdl), into a knock trace |tr| holding one bit per cycle
+% per run, ie. 1/8 of the memory of a logical array and 1/64 of a double array.  Knock levels or
+% intensities are stored as knock events |knocking>0|.  The structure |tr| has fields |words|, a
+% |[ceil(numCycles/64) x numRuns]| |uint64| array in which bit |b| (0..63) of word |w| is cycle
+% |64*(w-1)+b+1| of the trace, |numCycles| and |numRuns|.  A trace of 10^5 runs of 10^5 cycles
+% takes 1.25 GB.
+%
+% |tr= knkTrace(knocking,tr)| appends the cycles |knocking| to the existing trace |tr|, so that long
+% simulations can be packed block by block as they are continued, without ever holding the
+% unpacked history, (see the example).
+%
+% |knocking= knkTrace(tr)| unpacks the whole trace into a logical array, and
+% |knocking= knkTrace(tr,cycles)| unpacks only the cycles |cycles| (row indices of the trace).
+%
+% Examples
+% [~,knocking,simState]= simKnk(1000,ctl,plant,1e5);
+% tr= knkTrace(knocking(1:1000,:));                       % cycles 0..999
+% for i=1:99,                                             % 10^5 cycles of 10^5 runs, in blocks
+%     [~,knocking,simState]= simKnk(1000,ctl,plant,simState);
+%     tr= knkTrace(knocking(1:end-1,:),tr);               % cycles 1000*i..1000*i+999
+% end;
+% st= knkStats(tr,100);                                   % Knock counts, bursts and intervals
+%
+% See also
+% knkStats popCount simKnk snapKnk
+
+
+if ~isstruct(in),
+
+    % Pack, (appending to an existing trace if given)
+    knocking= in~=0;
+    if (nargin>=2) && ~isempty(arg2),
+        tr= arg2;
+        if size(knocking,2)~=tr.numRuns, error('knocking must have one column per run of the trace'); end;
+        numFull= floor(tr.numCycles/64);
+        knocking= [knkTrace(tr,[64*numFull+1:tr.numCycles]); knocking];   % re-pack the last partial word
+        out= tr;
+        out.words= [tr.words(1:numFull,:); packWords(knocking)];
+        out.numCycles= 64*numFull + size(knocking,1);
+    else
+        out.words= packWords(knocking);
+        out.numCycles= size(knocking,1);
+        out.numRuns= size(knocking,2);
+    end;
+
+else
+
+    % Unpack all, or selected, cycles
+    tr= in;
+    if (nargin<2)||isempty(arg2), cycles= [1:tr.numCycles]'; else cycles= arg2(:); end;
+    if isempty(cycles), out= false(0,tr.numRuns); return; end;
+    w= floor((cycles-1)/64) + 1;
+    words= tr.words(min(w):max(w),:);
+    bits= unpackWords(words);
+    out= bits(cycles - 64*(min(w)-1),:);
+
+end;
+
+
+
+function words= packWords(k)
+
+% Pack the logical [numCycles x numRuns] array k into uint64 words, a block of runs at a time
+[n,numRuns]= size(k);
+numWords= ceil(n/64);
+words= zeros(numWords,numRuns,'uint64');
+if numWords==0, return; end;
+blk= max(1,floor(2^24/(64*numWords)));
+for r0=1:blk:numRuns,
+    r= r0:min(r0+blk-1,numRuns);
+    kb= false(64*numWords,length(r));
+    kb(1:n,:)= k(:,r);
+    bytes= uint8(2.^[0:7]*reshape(double(kb),8,[]));
+    words(:,r)= reshape(typecast(bytes(:),'uint64'),numWords,length(r));
+end;
+
+
+function k= unpackWords(words)
+
+% Unpack uint64 words into a logical [64*numWords x numRuns] array
+[numWords,numRuns]= size(words);
+bytes= typecast(words(:),'uint8');
+k= false(8,length(bytes));
+for b=1:8,
+    k(b,:)= bitget(bytes,b)';
+end;
+k= reshape(k,64*numWords,numRuns);
@@ -0,0 +1,140 @@
+function [kpi,drv]= kpiKnk(cdfData,drv)
+
+% kpiKnk Knock control performance metrics of plotDriver, from the empirical cdfs of a spark sweep
+%
+% Syntax
+% [kpi,drv]= kpiKnk(cdfData)
+% [kpi,drv]= kpiKnk(cdfData,drv)
+% [~,drv]= kpiKnk([],drv)
+%
+% Description
+% |[kpi,drv]= kpiKnk(cdfData,drv)| runs the analysis of plotDriver as a function, for one cylinder,
+% given the empirical cdfs |cdfData| of a spark sweep, (see eCdf): the borderline knock threshold
+% and high intensity threshold, (p2x), the knock probability curves, (knockP), the limited
+% actuator resolution, the state transition matrices, (as markovMx, but sparse), the steady state,
+% the transients from several initial spark angles, (pdfSpk, mSpk, mKnk), the pdf of the number
+% of knock events, (pdfKnk), and the response times, (respT).  The settings are given by the
+% fields of the structure |drv|, with defaults, (in brackets), as in plotDriver:
+%   |BLindx|    index of the borderline experiment in |cdfData|, (5)
+%   |cyl|       cylinder, ie. column of |cdfData.x|, to be analyzed, (1)
+%   |theta|     controller states, (|[-3.9:0.015:2]'|)
+%   |delta|     spark angle actuator resolution, (0.105)
+%   |gains|     controller gains |[m1 m2 m1_High m2_High]|, (|[1 99 4 150]|)
+%   |kpTarg|    borderline cdf targets of the knock and high intensity thresholds, (|[0.99 0.995]|),
+%               or a scalar for a single level controller
+%   |myAngles|  initial spark angles of the transients, (|[0 0.7 1.6 -0.7 -1.6]|)
+%   |n|         number of cycles of the transients, and of the knock event pdfs, (|[250 100]|)
+%
+% The thresholds are the quantiles of the borderline cdf of the cylinder itself, so, since the
+% knock probability curves do not depend on the scaling of the intensities, the normalization of
+% plotDriver (normCdf) is not needed.  The output structure |kpi| contains the fields:
+%   |Tx|        the knock threshold(s), |[1 x length(kpTarg)]|
+%   |pPoints|   the knock probabilities at the measured spark angles, |[numExpts x length(kpTarg)]|
+%   |pCurve|    the knock probability of each controller state, (myPcurve1 of plotDriver)
+%   |pCurve_High| the high intensity knock probability of each state, (empty for a single level)
+%   |ssSpk|     the steady state mean and standard deviation of spark angle, (SSspkStats)
+%   |ssKnock|   the steady state mean and standard deviation of knock probability, (SSpStats)
+%   |Pinf|      the steady state pdf of the controller states
+%   |spkTraj|   the ensemble mean spark angle from each of |myAngles|, |[(n(1)+1) x numAngles]|
+%   |knockTraj| the ensemble mean knock probability from each of |myAngles|, (same size)
+%   |mSpk|      the time-averaged mean spark angle, |[numAngles x (n(1)+1)]|, (see mSpk)
+%   |mKnk|      the expected number of knock events, |[numAngles x (n(1)+1)]|, (see mKnk)
+%   |Pnk|       the pdf of the number of knock events in |n(2)| cycles, |[numAngles x (n(2)+1)]|,
+%               (see pdfKnk, counting knock events of either level)
+%   |T|, |nk|   the expected response times and knock events from each controller state to the
+%               steady state mean spark angle, (see respT)
+%
+% The output |drv| is the completed settings, including the field |lat|, the actuated angles and
+% the advance and retard state indexes, which are common to every cdf.  Passing |drv| back in to
+% further calls reuses them, eg. for bootstrap replicates or for other cylinders, and
+% |[~,drv]= kpiKnk([],drv)| only completes the settings, without analyzing any data.
+%
+% Examples
+% load sweep;
+% myCdf= eCdf(d,sa,[1:6]);
+% [kpi,drv]= kpiKnk(myCdf);                                 % Cylinder #1, as plotDriver
+% drv.cyl= 3; kpi3= kpiKnk(myCdf,drv);                      % ...and cylinder #3, reusing drv.lat
+%
+% See also
+% plotDriver bootKnk eCdf p2x knockP markovMx pdfSpk mSpk mKnk pdfKnk respT
+
+
+% Check input arguments, and fill in the plotDriver defaults
+if (nargin<2)||isempty(drv), drv= struct(); end;
+defaults= {'BLindx',5; 'cyl',1; 'theta',[-3.9:0.015:2]'; 'delta',0.105; 'gains',[1 99 4 150];...
+           'kpTarg',[0.99 0.995]; 'myAngles',[0 0.7 1.6 -0.7 -1.6]; 'n',[250 100]};
+for i=1:size(defaults,1),
+    if ~isfield(drv,defaults{i,1}) || isempty(drv.(defaults{i,1})), drv.(defaults{i,1})= defaults{i,2}; end;
+end;
+if length(drv.gains)<4, drv.gains(3:4)= drv.gains(1:2); end;
+if length(drv.n)<2, drv.n(2)= drv.n(1); end;
+theta= drv.theta(:);
+
+% Actuated angles and advance / retard structure, (as markovMx, indexed from zero), common to every cdf
+if ~isfield(drv,'lat') || isempty(drv.lat),
+    numStates= length(theta);
+    imax= numStates-1;
+    i= [0:imax]';
+    lat.theta1= floor((theta+5*eps)./drv.delta).*drv.delta;
+    lat.from= [i; i; i] + 1;
+    lat.to= [i + min(drv.gains(1),imax-i); i - min(drv.gains(2),i); i - min(drv.gains(4),i)] + 1;
+    drv.lat= lat;
+end;
+if isempty(cdfData), kpi= []; return; end;
+lat= drv.lat;
+theta1= lat.theta1;
+numStates= length(theta1);
+levels= length(drv.kpTarg)>1;
+
+% Knock thresholds and knock probability curves
+Tx= p2x(drv.kpTarg(:),cdfData(drv.BLindx),drv.cyl);
+kpi.Tx= Tx(:)';
+pCurves= knockP(Tx(:),cdfData,drv.cyl,theta);
+kpi.pPoints= reshape(knockP(Tx(:),cdfData,drv.cyl,[cdfData.theta]'),length(cdfData),[]);
+p= interp1(theta,pCurves(:,1,1),theta1,'PCHIP');
+pH= zeros(numStates,1);
+kpi.pCurve= p;
+kpi.pCurve_High= [];
+if levels,
+    pH= interp1(theta,pCurves(:,1,2),theta1,'PCHIP');
+    kpi.pCurve_High= pH;
+end;
+
+% Sparse state transition matrices
+M= sparse(lat.from,lat.to,[1-p; p-pH; pH],numStates,numStates);
+Madv= sparse(lat.from(1:numStates),lat.to(1:numStates),1-p,numStates,numStates);
+Mknk= M - Madv;                                                         % Either level of knock
+
+% Steady state, (Pinf'*M= Pinf' with sum(Pinf)= 1)
+I= speye(numStates);
+e= ones(numStates,1);
+x= [I-M', e; e', 0] \ [zeros(numStates,1); 1];
+Pinf= x(1:numStates);
+kpi.ssSpk= [theta1'*Pinf, sqrt(max(theta1.^2'*Pinf - (theta1'*Pinf)^2,0))];
+kpi.ssKnock= [p'*Pinf, sqrt(max(p.^2'*Pinf - (p'*Pinf)^2,0))];
+kpi.Pinf= Pinf;
+
+% Transients from each initial spark angle
+n= drv.n(1);
+numAngles= length(drv.myAngles);
+kpi.spkTraj= zeros(n+1,numAngles);
+kpi.knockTraj= zeros(n+1,numAngles);
+for j=1:numAngles,
+    [~,spkStats,pStats]= pdfSpk([0:n],M,drv.myAngles(j),theta1,p);
+    kpi.spkTraj(:,j)= spkStats(1,:)';
+    kpi.knockTraj(:,j)= pStats(1,:)';
+end;
+kpi.mSpk= mSpk(n,M,theta1,drv.myAngles);
+kpi.mKnk= mKnk(n,M,p,theta1,drv.myAngles);
+kpi.Pnk= pdfKnk(drv.n(2),Madv,Mknk,theta1,drv.myAngles);
+
+% Response times and knock events to the steady state mean spark angle, (as respT)
+k= find(theta1<kpi.ssSpk(1),1,'last')+1;
+[r,c,v]= find(M);
+kept= ~(((r>=k) & (c<=k)) | ((r<=k) & (c>=k)));
+A= I - sparse(r(kept),c(kept),v(kept),numStates,numStates);
+C= e; C(k)= 0;
+D= p; D(k)= 0;
+Tnk= A \ [C D];
+kpi.T= Tnk(:,1);
+kpi.nk= Tnk(:,2);
@@ -0,0 +1,114 @@
+function [idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0,x0,seed)
+
+% latKnk Monte Carlo closed-loop simulation of a traditional knock controller on the Markov chain state lattice
+%
+% Syntax
+% [idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0)
+% [idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0,numRuns)
+% [idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0,numRuns,seed)
+% [idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,[],simState)
+%
+% Description
+% |[idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0)| simulates |n| cycles of the
+% closed-loop traditional knock controller with the controller state held as an integer index on
+% the state lattice |theta| of the Markov chain analysis, rather than as a floating point spark
+% angle that accumulates roundoff, (see simKnk).  The knock probabilities of each state are the
+% tables |pCurve| and |pCurve_High|, (which may be empty |[]| for a single level controller), and
+% |gains= [m1 m2 m1_High m2_High]| are the controller steps, (|[m1 m2]| for a single level
+% controller), all exactly as in markovMx.  |i0| is the initial state index, (1-based).
+%
+% On each cycle, a run in state |i| knocks at level 2 if |u<pCurve_High(i)|, at level 1 if
+% |pCurve_High(i)<=u<pCurve(i)|, and does not knock otherwise, where |u| is a uniform random
+% number, and moves to the precomputed next state for that level, i.e. |i+min(m1,imax-i)|,
+% |i-min(m2,i)| or |i-min(m2_High,i)|, indexed from zero as in markovMx.  The transition
+% probabilities of every run are therefore exactly the rows of |M| from markovMx, so the simulated
+% distributions converge to those of pdfSpk and pdfKnk without any discretization error, and
+% each step is one table read for the knock probability and one for the next state.
+%
+% Output |idx| is the |[(n+1) x numRuns]| |int32| array of state indices at cycles |[0:n]|, so that
+% the spark angles are |theta(idx)|, and |knocking| is the logical knock flag, (or knock level
+% 0,1,2 if |pCurve_High| is given), of each cycle, with the same conventions as simKnk.  The number
+% of knock events in the first |n| cycles is therefore |sum(knocking(1:n,:)>0)|.
+%
+% |[idx,knocking,simState]= latKnk(n,pCurve,pCurve_High,gains,i0,numRuns,seed)| simulates
+% |numRuns| runs, (default 1), with the random number seed |seed|, (default 0, or |[seed
+% substream]|, see simKnk), and |latKnk(n,pCurve,pCurve_High,gains,[],simState)| continues from the
+% output state |simState| of a previous simulation.
+%
+% Examples
+% [M,Madv,Mret]= markovMx(myPcurve1,myPcurve1_High,m1,m2,m1_High,m2_High);
+% i0= find(theta>=0,1,'first');
+% [idx,knocking]= latKnk(10000,myPcurve1,myPcurve1_High,[m1 m2 m1_High m2_High],i0,1000);
+% relSpark= theta(idx);                                        % Spark angles of every run and cycle
+% Pn= pdfSpk(10000,M,0,theta,myPcurve1);                       % ...distribution they converge to
+%
+% See also
+% simKnk markovMx pdfSpk pdfKnk
+
+
+% Check input arguments
+if (nargin<6)||isempty(x0), x0= 1; end;
+if (nargin<7)||isempty(seed), seed= 0; end;
+if length(gains)<4, gains(3:4)= gains(1:2); end;
+numStates= length(pCurve);
+levels= ~isempty(pCurve_High);
+if ~levels, pCurve_High= zeros(numStates,1); end;
+
+% Knock probability and next state tables, (as markovMx, indexed from zero)
+imax= numStates-1;
+i= int32([0:imax]');
+next= [i + min(gains(1),imax-i), i - min(gains(2),i), i - min(gains(4),i)] + 1;
+P= pCurve(:);
+PH= pCurve_High(:);
+
+% Initialize, or continue from a previous simulation state
+if isstruct(x0),
+    simState= x0;
+    stream= RandStream('mrg32k3a','Seed',simState.seed(1));
+    stream.State= simState.rngState;
+    numRuns= length(simState.idx);
+else
+    numRuns= x0;
+    stream= RandStream('mrg32k3a','Seed',seed(1));
+    if length(seed)>1, stream.Substream= seed(2); end;
+    simState.seed= seed;
+    simState.cycle= 0;
+    simState.idx= int32(i0)*ones(numRuns,1,'int32');
+    u= rand(stream,numRuns,1);
+    simState.knocking= knockLevel(u,P(simState.idx),PH(simState.idx),levels);
+end;
+
+% Allocate space for the results
+idx= zeros(n+1,numRuns,'int32');
+knocking= false(n+1,numRuns);
+if levels, knocking= zeros(n+1,numRuns,'uint8'); end;
+idx(1,:)= simState.idx;
+knocking(1,:)= simState.knocking;
+
+% Simulate the closed loop on the lattice, drawing the random numbers in blocks of cycles
+s= simState.idx;
+knk= simState.knocking;
+blockSize= max(1,min(n,floor(2^20/numRuns)));
+for c0= 1:blockSize:n,
+    U= rand(stream,numRuns,min(blockSize,n-c0+1));
+    for j= 1:size(U,2),
+        s= next(s + numStates*int32(knk));                      % Knock Control
+        knk= knockLevel(U(:,j),P(s),PH(s),levels);              % Knock + Engine Simulator
+        idx(c0+j,:)= s;
+        knocking(c0+j,:)= knk;
+    end;
+end;
+
+% Output the final simulation state
+simState.cycle= simState.cycle + n;
+simState.idx= s;
+simState.knocking= knk;
+simState.rngState= stream.State;
+
+
+
+function knk= knockLevel(u,p,pH,levels)
+
+% Knock flag, or knock level 0,1,2, given uniform random numbers u
+knk= u<p;
+if levels, knk= uint8(knk) + uint8(u<pH); end;
@@ -0,0 +1,101 @@
+function [Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta,pCurve,tol)
+
+% lumpMx Lumped (reduced) state transition matrices for quantized actuator states
+%
+% Syntax
+% [Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta,pCurve)
+% [Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta,pCurve,tol)
+%
+% Description
+% |[Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta,pCurve)| returns reduced state transition
+% matrices |Mr|, |Madvr|, |Mretr| for a Markov chain in which all controller states that share
+% the same actuated angle |theta| and knock probability |pCurve|, and which also have identical
+% transition probabilities into every other group of states, are lumped into a single state.
+% The partition is found by iterative refinement, starting from the groups of equal
+% |[theta pCurve]|, and is the coarsest partition for which |M|, |Madv| and |Mret| are all
+% exactly lumpable.  Either of |Madv|, |Mret| may be empty |[]| if not required.
+%
+% The output structure |lumpData| contains the fields:
+%   |lumpData.theta|, |lumpData.pCurve|  reduced angle and knock probability vectors for use with
+%                                        pdfSpk, mSpk, mKnk, respT etc. in place of theta, pCurve
+%   |lumpData.block|                     the reduced state index of each original state, so that
+%                                        results indexed by initial state map back to the full grid
+%                                        as |x= xr(lumpData.block)|
+%   |lumpData.V|                         the sparse [numStates x numBlocks] membership matrix, so that
+%                                        a full grid pdf |Pn| aggregates as |V'*Pn|
+%   |lumpData.err|                       the lumping error bound, max_i ||(M*V)(i,:)-(V*Mr)(i,:)||_1
+%   |lumpData.exact|                     true if the lumping is exact (|err| is at roundoff level)
+%
+% |[Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta,pCurve,tol)| with |tol>0| performs
+% approximate lumping in which transition probabilities into each group are only required to agree
+% to within the quantization level |tol|.  Rows are then averaged within each group, and the
+% aggregated pdf after |n| cycles differs from |V'*Pn| of the full chain by at most |n*lumpData.err|
+% in the 1-norm.
+%
+% Examples
+% [M,Madv,Mret]= markovMx(myPcurve1,myPcurve1_High,m1,m2,m1_High,m2_High);
+% [Mr,Madvr,Mretr,lumpData]= lumpMx(M,Madv,Mret,theta1,myPcurve1,1e-3);
+% [T,nk]= respT(Mr,SSspkStats(1),lumpData.theta,lumpData.pCurve);   % Reduced chain response times
+% T= T(lumpData.block);                                               % ...mapped back to the full grid
+%
+% See also
+% markovMx compress
+
+
+% Check input arguments
+if (nargin<6)||isempty(tol), tol= 0; end;
+numStates= size(M,1);
+Ms= {sparse(M)};
+if ~isempty(Madv), Ms{end+1}= sparse(Madv); end;
+if ~isempty(Mret), Ms{end+1}= sparse(Mret); end;
+
+% Initial partition:  states with identical actuated angle and knock probability
+[~,~,block]= unique([theta(:) pCurve(:)],'rows');
+
+% Refine until each group has equal (to within tol) transition probabilities into every group
+numBlocks= 0;
+while numBlocks~=max(block),
+    numBlocks= max(block);
+    V= sparse([1:numStates]',block,1,numStates,numBlocks);
+    R= [];
+    for i=1:length(Ms), R= [R, Ms{i}*V]; end;
+    [~,~,block]= unique(rowSignature(R,block,tol),'rows');
+end;
+
+% Construct the reduced chain by averaging the aggregated rows within each group
+V= sparse([1:numStates]',block,1,numStates,numBlocks);
+U= spdiags(1./full(sum(V,1))',0,numBlocks,numBlocks) * V';
+Mr= full(U*Ms{1}*V);
+Madvr= []; Mretr= [];
+if ~isempty(Madv), Madvr= full(U*sparse(Madv)*V); end;
+if ~isempty(Mret), Mretr= full(U*sparse(Mret)*V); end;
+
+% Output the mapping and the lumping error bound
+lumpData.theta= U*theta(:);
+lumpData.pCurve= U*pCurve(:);
+lumpData.block= block;
+lumpData.V= V;
+lumpData.err= full(max(sum(abs(Ms{1}*V - V*Mr),2)));
+lumpData.exact= lumpData.err <= 100*eps*numStates;
+
+
+
+function sig= rowSignature(R,block,tol)
+
+% Signature [block, (column,value) pairs...] of each row of sparse R, with values quantized to tol
+numStates= size(R,1);
+[i,j,v]= find(R);
+if tol>0, v= round(v/tol); end;
+keep= v~=0;
+i= i(keep); j= j(keep); v= v(keep);
+[~,ord]= sortrows([i j]);
+i= i(ord); j= j(ord); v= v(ord);
+cnt= accumarray(i,1,[numStates 1]);
+starts= cumsum([1; cnt(1:end-1)]);
+pos= [1:length(i)]' - starts(i) + 1;
+width= max([cnt;1]);
+J= zeros(numStates,width);
+W= zeros(numStates,width);
+J(sub2ind(size(J),i,pos))= j;
+W(sub2ind(size(W),i,pos))= v;
+sig= [block(:), J, W];
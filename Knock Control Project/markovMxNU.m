@@ -0,0 +1,111 @@
+function [M,Madv,Mret,cmp]= markovMxNU(theta,pCurve,pCurve_High,advStep,retStep,retStep_High,fine)
+
+% markovMxNU Construct state transition matrices for a traditional knock controller on a non-uniform grid
+%
+% Syntax
+% [M,Madv,Mret]= markovMxNU(theta,pCurve,pCurve_High,advStep,retStep,retStep_High)
+% [M,Madv,Mret,cmp]= markovMxNU(theta,pCurve,pCurve_High,advStep,retStep,retStep_High,fine)
+%
+% Description
+% |[M,Madv,Mret]= markovMxNU(theta,pCurve,pCurve_High,advStep,retStep,retStep_High)| returns the 
+% [numStates x numStates] state transition matrices for a traditional knock controller whose 
+% states are the (possibly non-uniform) ascending spark angles |theta|, eg. from thetaGrid, given 
+% |pCurve| and |pCurve_High|, vectors of the knock and high intensity knock probabilities at 
+% each state, and the controller advance step |advStep|, retard step |retStep| and high intensity
+% retard step |retStep_High|, all in degrees, (eg. |advStep= m1*Delta|).
+%
+% An advance or retard step that does not land on a grid point is split between the two adjacent 
+% grid points, with probabilities chosen to preserve the expected spark angle after the step. 
+% Where the grid is uniform with spacing |Delta| and the steps are multiples of |Delta|, the 
+% matrices are identical to those of markovMx.  Steps beyond either end of the grid saturate at 
+% the end state, as in markovMx.  The outputs have the same meaning as those of markovMx, so they 
+% may be used directly with pdfSpk, pdfKnk, mKnk, mSpk and respT.
+%
+% The split is not exact:  it preserves the mean of each step, but adds a variance of up to
+% |h^2/4| per cycle, where |h| is the local grid spacing, (an artificial diffusion), and the knock
+% probability is sampled only at the grid points.  The spread of spark angle is therefore
+% overestimated where the grid is coarse, and the steady state mean spark angle and knock rate
+% shift where the knock probability curve is curved.  The error should be checked against the
+% uniform grid, as follows, and thetaGrid can refine the grid until it meets a tolerance.
+%
+% |[M,Madv,Mret,cmp]= markovMxNU(theta,pCurve,pCurve_High,advStep,retStep,retStep_High,fine)|
+% also compares the chain with that of markovMx on the uniform fine grid given by the structure
+% |fine|, with fields |theta|, |pCurve| and |pCurve_High|, (the uniform algorithm resolution
+% grid and knock probability curves from which |theta| was selected, eg. by thetaGrid), and
+% optionally |n|, the number of cycles of the transient, (default 250), and |theta0|, its initial
+% spark angle, which should be a state of both grids, (default 0, which thetaGrid retains).  The
+% steps must be multiples of the fine grid spacing.  The output structure |cmp| contains the
+% fields:
+%   |ssSpk|     the steady state mean spark angle, |[nonUniform uniform]|
+%   |ssKnock|   the steady state knock probability, |[nonUniform uniform]|
+%   |spkTraj|   the mean spark angle transient from |theta0|, |[(n+1) x 2]|
+%   |knockTraj| the mean knock probability transient from |theta0|, |[(n+1) x 2]|
+%   |maxErr|    the absolute errors |[ssSpk ssKnock max(spkTraj) max(knockTraj)]| of the
+%               non-uniform grid
+%
+% Examples
+% [thetaNU,pNU,indx]= thetaGrid(theta,[myPcurve1 myPcurve1_High],0.002);
+% [M,Madv,Mret]= markovMxNU(thetaNU,pNU(:,1),pNU(:,2),m1*Delta,m2*Delta,m2_High*Delta);
+% fine= struct('theta',theta,'pCurve',myPcurve1,'pCurve_High',myPcurve1_High);
+% [~,~,~,cmp]= markovMxNU(thetaNU,pNU(:,1),pNU(:,2),m1*Delta,m2*Delta,m2_High*Delta,fine);
+% cmp.maxErr                                       % Error of the non-uniform grid
+% 
+% See also
+% thetaGrid markovMx
+
+
+theta= theta(:); pCurve= pCurve(:); pCurve_High= pCurve_High(:);
+numStates= length(theta);
+
+% Construct the state transition matrices
+Madv= stepMx(theta, advStep, 1-pCurve);
+Mret= stepMx(theta,-retStep, pCurve-pCurve_High);
+Mret_High= stepMx(theta,-retStep_High, pCurve_High);
+M= Madv + Mret + Mret_High;
+
+% Compare with markovMx on the uniform fine grid, if required
+if nargout>=4,
+    if ~isfield(fine,'n') || isempty(fine.n), fine.n= 250; end;
+    if ~isfield(fine,'theta0') || isempty(fine.theta0), fine.theta0= 0; end;
+    Delta= fine.theta(2)-fine.theta(1);
+    m= round([advStep retStep retStep_High]/Delta);
+    Mf= markovMx(fine.pCurve(:),fine.pCurve_High(:),m(1),m(2),m(1),m(3));
+    [s1,k1,spk1,knk1]= chainStats(M,theta,pCurve,fine.n,fine.theta0);
+    [s2,k2,spk2,knk2]= chainStats(Mf,fine.theta(:),fine.pCurve(:),fine.n,fine.theta0);
+    cmp.ssSpk= [s1 s2];
+    cmp.ssKnock= [k1 k2];
+    cmp.spkTraj= [spk1 spk2];
+    cmp.knockTraj= [knk1 knk2];
+    cmp.maxErr= [abs(diff(cmp.ssSpk)) abs(diff(cmp.ssKnock)) ...
+                 max(abs(diff(cmp.spkTraj,1,2))) max(abs(diff(cmp.knockTraj,1,2)))];
+end;
+
+
+
+function A= stepMx(theta,step,prob)
+
+% Transition matrix for a step of 'step' degrees, taken with probability 'prob', split between
+% the two grid points adjacent to the target angle so as to preserve its mean
+numStates= length(theta);
+target= min(max(theta+step,theta(1)),theta(end));
+f= interp1(theta,[1:numStates]',target);                % fractional target index
+j= min(floor(f+1e-9),numStates-1);
+w= min(max(f-j,0),1);
+w(w<1e-9)= 0;
+A= full(sparse([1:numStates 1:numStates]',[j; j+1],[prob.*(1-w); prob.*w],numStates,numStates));
+
+
+function [ssSpk,ssKnock,spkTraj,knockTraj]= chainStats(M,theta,p,n,theta0)
+
+% Steady state mean spark angle and knock probability, (Pinf'*M= Pinf' with sum(Pinf)= 1), and
+% the mean transients over n cycles from the state theta0
+numStates= length(theta);
+e= ones(numStates,1);
+x= [eye(numStates)-M', e; e', 0] \ [zeros(numStates,1); 1];
+ssSpk= theta'*x(1:numStates);
+ssKnock= p'*x(1:numStates);
+P= zeros(numStates,n+1);
+P(find(theta>=theta0,1,'first'),1)= 1;
+for i=1:n, P(:,i+1)= M'*P(:,i); end;
+spkTraj= P'*theta;
+knockTraj= P'*p;
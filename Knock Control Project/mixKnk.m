@@ -0,0 +1,146 @@
+function mx= mixKnk(M,theta,numModes,tol,fig)
+
+% mixKnk Spectral gap, mixing time and slowest modes of a knock controller Markov chain
+%
+% Syntax
+% mx= mixKnk(M,theta)
+% mx= mixKnk(M,theta,numModes)
+% mx= mixKnk(M,theta,numModes,tol)
+% mx= mixKnk(M,theta,numModes,tol,fig)
+%
+% Description
+% |mx= mixKnk(M,theta)| returns the leading eigenvalues of the state transition matrix |M|, (see
+% markovMx), and the number of cycles the closed loop takes to forget its initial spark angle,
+% without propagating the pdf cycle by cycle as pdfSpk and mSpk do.  The eigenvalues of largest
+% modulus are found by the implicitly restarted Arnoldi method (eigs) applied to the sparse
+% transpose of |M|, so only sparse matrix-vector products are needed, rather than a dense
+% eigendecomposition.  |M| may be full or sparse; for large grids it should be built directly as
+% a sparse matrix, (see the example), since markovMx builds full matrices.  Chains of fewer than
+% 500 states are solved directly by eig.  An error is raised if eigs does not converge, eg. when
+% |lambda(2)| is very close to |lambda(1)|.
+%
+% The output structure |mx| contains the fields:
+%   |lambda|    the |numModes+1| eigenvalues of largest modulus, (default |numModes= 5|), in order
+%               of decreasing modulus, |lambda(1)= 1|
+%   |gap|       the spectral gap |1-abs(lambda(2))|
+%   |tRel|      the relaxation time |1/gap| cycles, the e-folding time of the slowest transient
+%   |horizon|   the number of cycles, |ceil(log(tol)/log(abs(lambda(2))))|, after which the slowest
+%               transient has decayed to the fraction |tol| of its initial amplitude, (default
+%               |tol= 1e-3|), eg. a transient horizon for pdfSpk, simKnk or xvalKnk
+%   |bound|     the mixing time estimate |ceil(tRel*log(1/(tol*piMin)))|, where |piMin| is the
+%               smallest steady state probability above 1e-10.  For a reversible chain, (eg.
+%               |m1=m2=1|), it is a bound after which the pdf from any initial spark angle is within
+%               |tol| of the steady state in total variation.  For a non-reversible chain, such as
+%               the default |m1=1, m2=99| controller, it is only a heuristic, since the transients
+%               of a non-normal |M| may exceed it by far
+%   |tvAtBound| the total variation distance from the steady state after |bound| cycles, of the
+%               pdfs started from the two end states, found by propagating them with sparse
+%               matrix-vector products.  A warning is given if it exceeds |tol|.  The end states
+%               are the extreme initial spark angles, but this is a check, not a proof, that no
+%               other initial pdf mixes more slowly
+%   |Pinf|      the steady state pdf, (as |pdfSpk(inf,...)|)
+%   |modes|     the |[numStates x numModes]| slowest modes, ie. the pdf shapes that decay as
+%               |lambda(k+1)^n|, each scaled to unit maximum modulus
+%   |spkAmp|    the change in mean spark angle |theta'*modes| carried by each mode, so that modes
+%               with |spkAmp| near zero do not delay the convergence of the mean spark angle
+% If |lambda(2)| has unit modulus, the chain has more than one closed class of states, or is
+% periodic, and does not forget its initial state; then |gap= 0| and |tRel|, |horizon| and |bound|
+% are |inf|.
+%
+% |mixKnk(-)| with no left hand arguments, or |mixKnk(-,'Fig')| with specified input |'Fig'|, plots
+% the eigenvalues in the complex plane, and the slowest modes as a function of spark angle.
+%
+% Examples
+% [M,Madv,Mret]= markovMx(myPcurve1,myPcurve1_High,m1,m2,m1_High,m2_High);
+% mx= mixKnk(M,theta,5,1e-3,'Fig');
+% Pn= pdfSpk([0:mx.horizon],M,0,theta,myPcurve1);              % Transient over the horizon only
+%
+% theta= [-3:0.0002:2]'; p= knockP(tradTx,myCdf,1,theta);      % 25001 states, built sparse
+% i= [0:length(theta)-1]'; imax= i(end);
+% M= sparse([i;i]+1,[i+min(m1,imax-i); i-min(m2,i)]+1,[1-p; p],imax+1,imax+1);
+% mx= mixKnk(M,theta);
+%
+% See also
+% markovMx pdfSpk mSpk respT xvalKnk
+
+
+% Check input arguments
+if (nargin<3)||isempty(numModes), numModes= 5; end;
+if (nargin<4)||isempty(tol), tol= 1e-3; end;
+theta= theta(:);
+numStates= size(M,1);
+k= min(numModes+1,numStates);
+
+% Leading eigenvalues and (pdf shaped) eigenvectors of M', by Arnoldi iteration if large
+if numStates<500,
+    [V,D]= eig(full(M'));
+else
+    opts.tol= 1e-10;
+    opts.maxit= 1000;
+    k= min(k,numStates-2);
+    [V,D,flag]= eigs(sparse(M'),k,'lm',opts);
+    if flag~=0, error('eigs did not converge on the %d leading eigenvalues of M',k); end;
+end;
+lambda= diag(D);
+[~,order]= sort(abs(lambda),'descend');
+order= order(1:k);
+lambda= lambda(order);
+V= V(:,order);
+
+% Steady state pdf, (as pdfSpk)
+Pinf= abs(real(V(:,1)));
+Pinf= Pinf / sum(Pinf);
+Pinf(Pinf<1e-10)= 0;
+piMin= min(Pinf(Pinf>0));
+
+% Spectral gap, relaxation time and horizons
+mx.lambda= lambda;
+mx.gap= 0;
+if k>1, mx.gap= max(1-abs(lambda(2)),0); end;
+if mx.gap<1e-12,
+    mx.gap= 0;
+    mx.tRel= inf;
+    mx.horizon= inf;
+    mx.bound= inf;
+else
+    mx.tRel= 1/mx.gap;
+    mx.horizon= ceil(log(tol)/log(1-mx.gap));
+    mx.bound= ceil(mx.tRel*log(1/(tol*piMin)));
+end;
+mx.Pinf= Pinf;
+
+% Check the mixing time estimate from the extreme initial spark angles
+mx.tvAtBound= NaN;
+if isfinite(mx.bound),
+    Mt= sparse(M');
+    P= zeros(numStates,2);
+    P(1,1)= 1;
+    P(end,2)= 1;
+    for i=1:mx.bound, P= Mt*P; end;
+    mx.tvAtBound= max(0.5*sum(abs(bsxfun(@minus,P,Pinf)),1));
+    if mx.tvAtBound>tol,
+        warning('mixKnk:bound','After bound= %d cycles the pdf is still %.3g from the steady state in total variation',mx.bound,mx.tvAtBound);
+    end;
+end;
+
+% Slowest modes, and the mean spark angle carried by each
+modes= V(:,2:k);
+if ~isempty(modes), modes= bsxfun(@rdivide,modes,max(abs(modes),[],1)); end;
+mx.modes= modes;
+mx.spkAmp= (theta'*modes)';
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=5) && ~isempty(fig)),
+    figure, plot(real(lambda),imag(lambda),'o');
+    line(cos(2*pi*[0:360]/360),sin(2*pi*[0:360]/360),'color','k','linestyle',':');
+    axis equal;
+    xlabel('Real part');
+    ylabel('Imaginary part');
+    text(0.05,0.9,['|\lambda_2| = ' num2str(abs(lambda(min(2,k))),6) ',  horizon = ' num2str(mx.horizon) ' cycles'],'units','normalized');
+
+    figure, plot(theta,real(modes));
+    xlabel('Relative spark angle [deg]');
+    ylabel('Mode shape (real part) [-]');
+    legend(arrayfun(@(x) ['\lambda = ' num2str(x,4)],lambda(2:k),'UniformOutput',false));
+end;
@@ -0,0 +1,78 @@
+function p= opKnockP(map,speed,engLoad,theta,targ)
+
+% opKnockP Knock probability look-up from a speed/load operating point map
+%
+% Syntax
+% p= opKnockP(map,speed,engLoad,theta)
+% p= opKnockP(map,speed,engLoad,theta,targ)
+%
+% Description
+% |p= opKnockP(map,speed,engLoad,theta)| returns the knock probabilities at the spark angles |theta|
+% and operating points |(speed, engLoad)| from the operating point map |map|, (see opMap), by 
+% bilinear interpolation across the speed/load cells and linear interpolation in spark angle.
+% |speed|, |engLoad| and |theta| may be scalars or arrays of the same size, eg. one element per
+% simulated instance, and operating points outside the map are clamped to its edges.  Spark
+% angles outside |map.theta| are clamped too, so the knock probability is held at its end values,
+% whereas the table plant of simKnk, (|plant.knockGenTheta|, |plant.knockGenP|), extrapolates
+% linearly.  The cost of each look-up is independent of the number of spark angle states, and
+% the 8 corners of each cell are read from |map.pCurve| directly by linear index, without copying
+% the map.
+%
+% |p= opKnockP(map,speed,engLoad,theta,targ)| uses the knock probability curve for the |targ|-th
+% threshold in the map, eg. |targ=2| for the high intensity knock probability. Default |targ=1|.
+%
+% |p= opKnockP(map,speed,engLoad)| with |theta| omitted returns the whole knock probability curve on
+% the map's spark angle base |map.theta|, eg. for use with markovMx.
+%
+% Examples
+% p= opKnockP(map,2000*ones(1000,1),0.6*ones(1000,1),relSpk);   % per instance knock probability
+% pCurve= opKnockP(map,2000,0.6);                               % curve for one operating point
+% [M,Madv,Mret]= markovMx(pCurve,opKnockP(map,2000,0.6,[],2),m1,m2,m1_High,m2_High);
+%
+% See also
+% opMap markovMx
+
+
+% Check input arguments
+if (nargin<5)||isempty(targ), targ= 1; end;
+if (nargin<4)||isempty(theta), theta= map.theta; end;
+sz= size(theta);
+if isscalar(speed), speed= speed*ones(sz); end;
+if isscalar(engLoad), engLoad= engLoad*ones(sz); end;
+numTheta= length(map.theta);
+numSpeeds= length(map.speed);
+numLoads= length(map.load);
+
+% Fractional cell indices along each axis, clamped to the map
+[i1,f1]= fracIndex(map.speed,speed(:));
+[i2,f2]= fracIndex(map.load,engLoad(:));
+[i3,f3]= fracIndex(map.theta,theta(:));
+
+% Trilinear interpolation, from the linear indexes of the 8 corners of each cell
+j0= i3 + numTheta*((i1-1) + numSpeeds*((i2-1) + numLoads*(targ-1)));
+d1= numTheta*(i1<numSpeeds);
+d2= numTheta*numSpeeds*(i2<numLoads);
+d3= double(i3<numTheta);
+p= zeros(numel(theta),1);
+for a=0:1, for b=0:1, for c=0:1,
+    w= (a*f1+(1-a)*(1-f1)) .* (b*f2+(1-b)*(1-f2)) .* (c*f3+(1-c)*(1-f3));
+    p= p + w.*map.pCurve(j0 + a*d1 + b*d2 + c*d3);
+end; end; end;
+p= reshape(p,sz);
+
+
+
+function [i,f]= fracIndex(x,xq)
+
+% Lower breakpoint index i (1 <= i < n) and fraction f in [0,1] of each query point xq
+n= length(x);
+if n==1, i= ones(size(xq)); f= zeros(size(xq)); return; end;
+xq= min(max(xq,x(1)),x(end));
+if all(abs(diff(x)-(x(2)-x(1)))<1e-9*max(abs(x))+eps),
+    f= (xq-x(1))/(x(2)-x(1));                            % uniform breakpoints: direct indexing
+else
+    f= interp1(x(:),[0:n-1]',xq);
+end;
+i= min(floor(f),n-2);
+f= f-i;
+i= i+1;
@@ -0,0 +1,85 @@
+function map= opMap(sweeps,theta,cyl,kpTarg,fig)
+
+% opMap Speed/load operating point map of knock probability curves and thresholds
+%
+% Syntax
+% map= opMap(sweeps,theta)
+% map= opMap(sweeps,theta,cyl)
+% map= opMap(sweeps,theta,cyl,kpTarg)
+% map= opMap(sweeps,theta,cyl,kpTarg,fig)
+%
+% Description
+% |map= opMap(sweeps,theta)| builds an operating point map from a structure array |sweeps| of spark
+% sweep experiments, one per (speed, load) cell of the engine map, each with fields |speed|, |load|,
+% |d| (the cell array of |[numCycles x numCylinders]| knock intensities, as in sweep.mat), |sa| (the
+% corresponding spark angles) and |BLindx| (the index of the borderline experiment).  For each cell,
+% the empirical cdfs are computed with eCdf, the knock threshold giving a knock probability of 1% at
+% borderline is found with p2x, and the knock probability curve is evaluated with knockP on the 
+% spark angle base |theta|, exactly as in plotDriver.  The cells are processed in parallel (parfor).
+%
+% The output structure |map| contains the fields |speed| and |load|, (the sorted unique
+% breakpoints, which must form a complete grid), |theta|, |Tx| (the |[numSpeeds x numLoads x numTarg]|
+% thresholds), and |pCurve| (the |[length(theta) x numSpeeds x numLoads x numTarg]| knock probability
+% curves).  Use opKnockP to look up knock probabilities from the map.
+%
+% |map= opMap(sweeps,theta,cyl)| uses cylinder |cyl|, (default 1), and |map= opMap(sweeps,theta,cyl,kpTarg)|
+% uses the borderline knock probability targets |1-kpTarg|, (default |kpTarg= 0.99|).  Two targets,
+% eg. |kpTarg= [0.99 0.995]|, give the knock and high intensity knock probability curves.
+%
+% |opMap(-)| with no left hand arguments, or |opMap(-,'Fig')| with specified input |'Fig'|, 
+% plots the borderline knock threshold over the engine map.
+%
+% Examples
+% map= opMap(sweeps,[-3.9:0.015:2]',1,[0.99 0.995]);
+% p= opKnockP(map,2000,0.6,relSpk);        % knock probability at 2000 rpm, 60% load
+%
+% See also
+% opKnockP knockP eCdf p2x
+
+
+% Check input arguments
+if (nargin<3)||isempty(cyl), cyl= 1; end;
+if (nargin<4)||isempty(kpTarg), kpTarg= 0.99; end;
+theta= theta(:);
+map.speed= unique([sweeps.speed]);
+map.load= unique([sweeps.load]);
+map.theta= theta;
+numCells= length(map.speed)*length(map.load);
+if (length([sweeps.speed])~=length(sweeps)) || (length([sweeps.load])~=length(sweeps)),
+    error('Each sweep must have a scalar speed and load');
+end;
+[isSpeed,speedIndx]= ismember([sweeps.speed],map.speed);
+[isLoad,loadIndx]= ismember([sweeps.load],map.load);
+if ~all(isSpeed & isLoad),
+    error('The speed or load of sweep %d is not a breakpoint of the map, (eg. NaN)',find(~(isSpeed & isLoad),1));
+end;
+cellIndx= speedIndx(:) + length(map.speed)*(loadIndx(:)-1);
+if (length(sweeps)~=numCells) || (numel(unique(cellIndx))~=numCells),
+    error('sweeps must cover every (speed,load) cell of the map exactly once');
+end;
+
+% Knock threshold and knock probability curve for each cell
+Tx= zeros(numCells,length(kpTarg));
+pCurve= zeros(length(theta),numCells,length(kpTarg));
+parfor i=1:numCells,
+    myCdf= eCdf(sweeps(i).d,sweeps(i).sa,cyl);
+    myTx= p2x(kpTarg,myCdf(sweeps(i).BLindx),1);
+    myPcurves= knockP(myTx(:),myCdf,1,theta);
+    Tx(i,:)= myTx(:)';
+    pCurve(:,i,:)= myPcurves;
+end;
+map.Tx= zeros(length(map.speed),length(map.load),length(kpTarg));
+map.pCurve= zeros(length(theta),length(map.speed),length(map.load),length(kpTarg));
+for j=1:length(kpTarg),
+    T= zeros(length(map.speed),length(map.load)); T(cellIndx)= Tx(:,j);
+    map.Tx(:,:,j)= T;
+    P= zeros(length(theta),numCells); P(:,cellIndx)= pCurve(:,:,j);
+    map.pCurve(:,:,:,j)= reshape(P,length(theta),length(map.speed),length(map.load));
+end;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=5) && ~isempty(fig)),
+    figure, surf(map.load,map.speed,map.Tx(:,:,1));
+    xlabel('Load'); ylabel('Speed'); zlabel('Knock threshold');
+end;
@@ -0,0 +1,104 @@
+function pr= pairKnk(n,ctls,plant,numRuns,numSeeds,seed,warmUp,fig)
+
+% pairKnk Paired comparison of knock controller calibrations using common random numbers
+%
+% Syntax
+% pr= pairKnk(n,ctls,plant)
+% pr= pairKnk(n,ctls,plant,numRuns,numSeeds)
+% pr= pairKnk(n,ctls,plant,numRuns,numSeeds,seed)
+% pr= pairKnk(n,ctls,plant,numRuns,numSeeds,seed,warmUp)
+% pr= pairKnk(n,ctls,plant,numRuns,numSeeds,seed,warmUp,fig)
+%
+% Description
+% |pr= pairKnk(n,ctls,plant)| simulates |n| cycles of the closed loop with each of the controller
+% calibrations in the structure array |ctls|, (eg. different m1/m2 gains, see simKnk), and the
+% same plant |plant|, driving every calibration with identical random numbers, (common random
+% numbers).  Run |r| of every calibration sees the same uniform random number on every cycle, so
+% the differences between calibrations are due to the calibrations, and not to the different
+% random knock sequences that independent seeds, (eg. |rand('state',2000)| and
+% |rand('state',500)| in plotDriver), would give.
+%
+% Each run is summarized by its mean spark angle and its knock rate over cycles |warmUp+1| to |n|,
+% (default |warmUp= 0|), and the differences of each calibration from the first, |ctls(1)|, are
+% formed run by run.  The output structure |pr| contains the sub-structures |pr.spk| and
+% |pr.knock|, each with the fields:
+%   |mean|      the mean of each calibration, |[numCtls x 1]|
+%   |diff|      the mean paired difference from |ctls(1)|
+%   |se|        the standard error of |diff|
+%   |ci95|      95% confidence intervals on |diff|, |[numCtls x 2]|
+%   |varRatio|  the variance of |diff| for independent simulations divided by its variance for
+%               paired simulations, ie. the factor by which common random numbers reduce the
+%               number of runs needed to resolve the difference to the same precision
+% and |pr.numRuns|, the total number of runs of each calibration.
+%
+% |pr= pairKnk(n,ctls,plant,numRuns,numSeeds,seed)| simulates |numSeeds| blocks of |numRuns| runs,
+% (defaults 8 and 1000), in parallel (parfor) if a pool is open.  Block |i| uses substream |i| of
+% the 'mrg32k3a' stream with seed |seed|, (default 0), so blocks are independent, but each block
+% is identical for every calibration.
+%
+% |pairKnk(-)| with no left hand arguments, or |pairKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the paired differences with their confidence intervals.
+%
+% Examples
+% ctl= struct('initialSpark',0,'retardGain',99*Delta,'advanceGain',Delta,'spkMin',-3,'spkMax',2);
+% ctls= [ctl, setfield(ctl,'retardGain',80*Delta), setfield(ctl,'advanceGain',2*Delta)];
+% plant= struct('knockGenTheta',theta,'knockGenP',myPcurve1);
+% pr= pairKnk(10000,ctls,plant,1000,8,0,500,'Fig');
+%
+% See also
+% simKnk xvalKnk plotDriver
+
+
+% Check input arguments
+if (nargin<4)||isempty(numRuns), numRuns= 1000; end;
+if (nargin<5)||isempty(numSeeds), numSeeds= 8; end;
+if (nargin<6)||isempty(seed), seed= 0; end;
+if (nargin<7)||isempty(warmUp), warmUp= 0; end;
+numCtls= length(ctls);
+cycles= [warmUp+1:n];
+
+% Simulate every calibration on the same substream of each block
+spk= cell(numSeeds,1);
+knk= cell(numSeeds,1);
+parfor i=1:numSeeds,
+    s= zeros(numCtls,numRuns);
+    k= zeros(numCtls,numRuns);
+    for c=1:numCtls,
+        [relSpark,knocking]= simKnk(n,ctls(c),plant,numRuns,[seed i]);
+        s(c,:)= mean(double(relSpark(cycles+1,:)),1);
+        k(c,:)= mean(knocking(cycles,:)>0,1);
+    end;
+    spk{i}= s;
+    knk{i}= k;
+end;
+
+% Paired differences from the first calibration
+pr.spk= pairStats([spk{:}]);
+pr.knock= pairStats([knk{:}]);
+pr.numRuns= numRuns*numSeeds;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=8) && ~isempty(fig)),
+    figure, errorbar([1:numCtls],pr.spk.diff,pr.spk.diff-pr.spk.ci95(:,1),pr.spk.ci95(:,2)-pr.spk.diff,'o');
+    xlabel('Calibration');
+    ylabel('Mean spark angle difference [deg]');
+
+    figure, errorbar([1:numCtls],pr.knock.diff,pr.knock.diff-pr.knock.ci95(:,1),pr.knock.ci95(:,2)-pr.knock.diff,'o');
+    xlabel('Calibration');
+    ylabel('Knock rate difference');
+end;
+
+
+
+function st= pairStats(X)
+
+% Means, paired differences from row 1, and variance reduction, of the per run metrics X
+R= size(X,2);
+D= bsxfun(@minus,X,X(1,:));
+st.mean= mean(X,2);
+st.diff= mean(D,2);
+st.se= sqrt(var(D,0,2)/R);
+st.ci95= [st.diff-1.96*st.se, st.diff+1.96*st.se];
+st.varRatio= (var(X,0,2) + var(X(1,:))) ./ var(D,0,2);
+st.varRatio(1)= NaN;
@@ -0,0 +1,31 @@
+function n= popCount(w)
+
+% popCount Number of set bits in each element of an unsigned integer array
+%
+% Syntax
+% n= popCount(w)
+%
+% Description
+% |n= popCount(w)| returns the number of set bits (population count) in each element of the
+% |uint8|, |uint16|, |uint32| or |uint64| array |w|, as a double array of the same size.  The count
+% is made a byte at a time by table look-up, so it is exact for all 64 bits of |uint64| words,
+% (which MATLAB's saturating integer multiply does not allow with the usual shift-and-multiply
+% method), and it is vectorized over the whole array.
+%
+% Examples
+% popCount(uint64([0 1 3 2^40+7]))              % [0 1 2 4]
+% popCount(bitxor(mask,truthMask))              % Bits that differ, eg. misclassified thresholds
+%
+% See also
+% replayTx knkTrace knkStats
+
+
+% Byte table of counts
+persistent tab
+if isempty(tab), tab= sum(dec2bin(0:255)=='1',2); end;
+
+% Count a byte at a time
+sz= size(w);
+if isempty(w), n= zeros(sz); return; end;
+b= typecast(w(:),'uint8');
+n= reshape(sum(reshape(tab(double(b)+1),numel(b)/numel(w),[]),1),sz);
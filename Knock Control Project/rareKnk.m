@@ -0,0 +1,165 @@
+function [P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s,seed,wMax)
+
+% rareKnk Importance sampling estimate of the probability of a burst of consecutive knock events
+%
+% Syntax
+% [P,stats]= rareKnk(n,ctl,plant,r)
+% [P,stats]= rareKnk(n,ctl,plant,r,lvl)
+% [P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns)
+% [P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s)
+% [P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s,seed)
+% [P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s,seed,wMax)
+%
+% Description
+% |[P,stats]= rareKnk(n,ctl,plant,r)| returns an unbiased estimate |P| of the probability that the
+% closed loop formed by the controller |ctl| and plant |plant|, (see simKnk), experiences a burst of
+% at least |r| consecutive knock events within its first |n| cycles, starting from
+% |ctl.initialSpark|.  Such events are too rare to estimate by plain Monte Carlo simulation, so
+% the plant's knock probability |q| is exponentially tilted to |q*exp(s)/(1-q+q*exp(s))|, and
+% each run is weighted by its likelihood ratio.  The tilt is applied only in the cycles that
+% follow a knock event, ie. within the window of a burst that may become the target burst, and
+% the first knock of every burst is drawn with the untilted probability.  A tilted cycle that
+% continues the burst multiplies the likelihood ratio by |(1-q)*exp(-s)+q <= 1|, but one that ends
+% it multiplies it by |1-q+q*exp(s) > 1|, so the weight of a run would grow with every burst that
+% does not become the target burst, and hence with |n|.  A cycle is therefore tilted only if its
+% weight would remain at most |wMax| should the burst end, so every weight is at most |wMax|, and
+% the variance of |P| is at most |wMax*P/numRuns| for any |n|, (at most |wMax| times that of plain
+% Monte Carlo).  The weight cap depends only on the past of the run, so the estimate remains
+% unbiased.  Each run is stopped as soon as the burst occurs, which does not bias the estimate
+% either.
+%
+% The plant must be a knock probability plant of simKnk:  the table |plant.knockGenTheta|,
+% |plant.knockGenP|, (and |plant.knockGenP_High|), or the operating point map |plant.map|, with
+% |plant.speed|, |plant.load|, (and |plant.highTarg|).  The intensity plants |plant.cdfData| and
+% |plant.alias| are not supported, since the tilt needs the knock probability of each cycle.
+%
+% |[P,stats]= rareKnk(n,ctl,plant,r,lvl)| with |lvl=2| counts only high intensity knock events,
+% (which requires a high intensity knock probability and |ctl.retardGain_High|).  The default is
+% |lvl=1|, for which any knock event counts.
+%
+% |[P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s,seed)| uses |numRuns| tilted runs, (default 1e4),
+% a tilt parameter |s|, and random number seed |seed|, (default 0).  If |s| is empty or omitted,
+% pilot runs with |numRuns/10| runs are made over the grid |s= [0:0.5:5]| and the tilt giving the
+% smallest estimated variance is used.  |[P,stats]= rareKnk(n,ctl,plant,r,lvl,numRuns,s,seed,wMax)|
+% specifies the weight cap, (default |wMax= 10|).
+%
+% The output structure |stats| contains the fields |s| (the tilt used), |var| (the variance of
+% |P|), |relErr| (the relative standard error of |P|), |ci95| (a 95% confidence interval),
+% |varBound| (the bound |wMax*P/numRuns| on |var|), |maxW| (the largest weight of the runs),
+% |cycles| (the total number of cycles simulated, including pilots), |cyclesBruteForce| (the
+% number of cycles plain Monte Carlo would need for the same relative error), and |speedup|.
+%
+% Examples
+% ctl= struct('initialSpark',0,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2,...
+%             'retardGain_High',m2_High*Delta);
+% plant= struct('knockGenTheta',theta,'knockGenP',myPcurve1,'knockGenP_High',myPcurve1_High);
+% [P,stats]= rareKnk(1000,ctl,plant,3);         % P(>=3 consecutive knocks in 1000 cycles)
+% [P,stats]= rareKnk(1000,ctl,plant,2,2);       % P(>=2 consecutive high intensity knocks)
+%
+% See also
+% simKnk tailKnk
+
+
+% Check input arguments
+if (nargin<5)||isempty(lvl), lvl= 1; end;
+if (nargin<6)||isempty(numRuns), numRuns= 1e4; end;
+if (nargin<8)||isempty(seed), seed= 0; end;
+if (nargin<9)||isempty(wMax), wMax= 10; end;
+if ~isfield(ctl,'spkMin'), ctl.spkMin= -3; end;
+if ~isfield(ctl,'spkMax'), ctl.spkMax= 2; end;
+if isfield(plant,'cdfData') || isfield(plant,'alias'),
+    error('rareKnk requires a knock probability plant, (knockGenP or map), not an intensity plant');
+end;
+if ~isfield(plant,'map') && ~isfield(plant,'knockGenP'), error('plant should have the fields knockGenTheta and knockGenP, or map'); end;
+hasHigh= isfield(plant,'knockGenP_High') || (isfield(plant,'map') && isfield(plant,'highTarg'));
+if (lvl==2) && ~hasHigh, error('lvl=2 requires plant.knockGenP_High or plant.highTarg'); end;
+stream= RandStream('mrg32k3a','Seed',seed);
+cycles= 0;
+
+% Choose the tilt by pilot runs if not specified
+if (nargin<7)||isempty(s),
+    sGrid= [0:0.5:5];
+    v= inf(size(sGrid));
+    for i=1:length(sGrid),
+        [w,c]= tiltedRuns(n,ctl,plant,r,lvl,max(100,round(numRuns/10)),sGrid(i),wMax,stream);
+        cycles= cycles + c;
+        if any(w>0), v(i)= var(w)/mean(w)^2; end;
+    end;
+    [~,i]= min(v);
+    s= sGrid(i);
+end;
+
+% Importance sampling estimate
+[w,c]= tiltedRuns(n,ctl,plant,r,lvl,numRuns,s,wMax,stream);
+P= mean(w);
+stats.s= s;
+stats.var= var(w)/numRuns;
+stats.varBound= wMax*P/numRuns;
+stats.maxW= max(w);
+stats.relErr= sqrt(stats.var)/P;
+stats.ci95= P + [-1.96 1.96]*sqrt(stats.var);
+stats.cycles= cycles + c;
+stats.cyclesBruteForce= n*(1-P)/(P*stats.relErr^2);
+stats.speedup= stats.cyclesBruteForce/stats.cycles;
+
+
+
+function [w,cycles]= tiltedRuns(n,ctl,plant,r,lvl,numRuns,s,wMax,stream)
+
+% Likelihood-ratio weighted indicators of a burst of r knocks, for numRuns tilted runs, with weights capped at wMax
+relSpk= min(max(ctl.initialSpark*ones(numRuns,1),ctl.spkMin),ctl.spkMax);
+logLR= zeros(numRuns,1);
+burst= zeros(numRuns,1);
+active= true(numRuns,1);
+hit= false(numRuns,1);
+hasHigh= isfield(plant,'knockGenP_High') || (isfield(plant,'map') && isfield(plant,'highTarg'));
+cycles= 0;
+for t=1:n,
+    a= find(active);
+    if isempty(a), break; end;
+    cycles= cycles + length(a);
+    [p,pH]= knockProb(plant,double(relSpk(a)),t,hasHigh);
+
+    % Knock (level) generation, tilted within bursts, and likelihood ratio
+    if lvl==1, q= p; else q= pH; end;
+    qt= q;
+    c= 1-q+q*exp(s);                                        % weight factor if a tilted burst ends
+    b= (burst(a)>0) & (logLR(a)+log(c)<=log(wMax));
+    qt(b)= q(b)*exp(s)./c(b);
+    u= rand(stream,length(a),2);
+    qual= u(:,1)<qt;
+    if lvl==1,
+        level= uint8(qual) + uint8(qual & (u(:,2).*p<pH));
+    else
+        level= 2*uint8(qual) + uint8(~qual & (u(:,2).*(1-pH)<(p-pH)));
+    end;
+    lr= ones(size(q));
+    lr(b & ~qual)= (1-q(b & ~qual))./(1-qt(b & ~qual));
+    lr(b & qual)= q(b & qual)./qt(b & qual);
+    logLR(a)= logLR(a) + log(lr);
+
+    % Detect bursts, and stop runs that have completed one
+    burst(a)= (burst(a)+1).*qual;
+    hit(a)= burst(a)>=r;
+    active(a)= ~hit(a);
+    if hasHigh, relSpk(a)= knCtrl(relSpk(a),level,ctl);
+    else relSpk(a)= knCtrl(relSpk(a),level>0,ctl);
+    end;
+end;
+w= hit.*exp(logLR);
+
+
+function [p,pH]= knockProb(plant,x,t,hasHigh)
+
+% Knock, and high intensity knock, probabilities of the plant at spark angles x on cycle t, (as simKnk)
+pH= zeros(size(x));
+if isfield(plant,'map'),
+    i= min(t,length(plant.speed));
+    p= opKnockP(plant.map,plant.speed(i),plant.load(i),x);
+    if hasHigh, pH= opKnockP(plant.map,plant.speed(i),plant.load(i),x,plant.highTarg); end;
+else
+    p= interp1(plant.knockGenTheta,plant.knockGenP,x,'linear','extrap');
+    if hasHigh, pH= interp1(plant.knockGenTheta,plant.knockGenP_High,x,'linear','extrap'); end;
+end;
+p= min(max(p,0),1);
+pH= min(max(pH,0),p);
@@ -0,0 +1,106 @@
+function rec= recovKnk(ctl,map,ops,dwell,numVisits,numRuns,seed,fig)
+
+% recovKnk Recovery of the traditional and borderline learning knock controllers on re-entry to an operating point
+%
+% Syntax
+% rec= recovKnk(ctl,map,ops)
+% rec= recovKnk(ctl,map,ops,dwell,numVisits)
+% rec= recovKnk(ctl,map,ops,dwell,numVisits,numRuns,seed)
+% rec= recovKnk(ctl,map,ops,dwell,numVisits,numRuns,seed,fig)
+%
+% Description
+% |rec= recovKnk(ctl,map,ops)| simulates a drive cycle that dwells for |dwell| cycles at each of the
+% speed/load operating points |ops= [speed load]|, (one per row), in turn, and repeats the sequence
+% |numVisits| times, using the operating point map |map|, (see opMap and simKnk).  The drive cycle
+% is simulated both with the borderline learning controller |ctl|, (see knLearn), and with the
+% same controller without learning, (knCtrl), using common random numbers, so that the difference
+% between the two is due to the learning alone.
+%
+% On every re-entry to an operating point, (ie. every visit after the first), the response time
+% is the number of cycles taken to reach or cross the target spark angle of that operating point,
+% as in respT, and the recovery knock count is the number of knock events in that interval.  The
+% target |rec.thetaTarg| is the ensemble mean spark angle of the traditional controller over the
+% second half of its dwells at that operating point.  Responses that do not reach the target
+% within the dwell are censored at |dwell| cycles.
+%
+% The output structure |rec| contains the fields |thetaTarg|, |T| and |nk|, (the mean response
+% times and recovery knock counts, |[numOps x 2]| for the traditional and learning controllers),
+% |meanT| and |meanNk|, (their averages over all operating points), |reductionT| and
+% |reductionNk|, (the fractional reductions due to learning), and |time|, (the simulation time per
+% run-cycle of each controller, in seconds).  The defaults are |dwell= 500|, |numVisits= 3|,
+% |numRuns= 1000| and |seed= 0|.
+%
+% |recovKnk(-)| with no left hand arguments, or |recovKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the ensemble mean spark angle of both controllers over the drive cycle.
+%
+% Examples
+% ctl= struct('initialSpark',0,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2,...
+%             'learnGain',1/32,'learnMargin',0);
+% map= opMap(sweeps,theta,1,0.99);
+% rec= recovKnk(ctl,map,[1500 0.4; 3000 0.8; 2000 0.6],500,3,1000,0,'Fig');
+%
+% See also
+% knLearn simKnk respT opMap
+
+
+% Check input arguments
+if (nargin<4)||isempty(dwell), dwell= 500; end;
+if (nargin<5)||isempty(numVisits), numVisits= 3; end;
+if (nargin<6)||isempty(numRuns), numRuns= 1000; end;
+if (nargin<7)||isempty(seed), seed= 0; end;
+if ~isfield(ctl,'learnGain'), ctl.learnGain= 1/32; end;
+numOps= size(ops,1);
+
+% Drive cycle, and the traditional controller
+k= repmat(kron([1:numOps]',ones(dwell,1)),numVisits,1);
+n= length(k);
+plant= struct('map',map,'speed',ops(k,1),'load',ops(k,2));
+if (size(map.pCurve,4)>1) && isfield(ctl,'retardGain_High'), plant.highTarg= 2; end;
+names= intersect(fieldnames(ctl),{'learnGain','learnMargin','cellSpeed','cellLoad'});
+ctl0= rmfield(ctl,names);
+
+% Simulate both controllers with common random numbers
+tic; [spk0,knk0]= simKnk(n-1,ctl0,plant,numRuns,seed); time(1)= toc;
+tic; [spk1,knk1]= simKnk(n-1,ctl,plant,numRuns,seed); time(2)= toc;
+spk= {double(spk0), double(spk1)};
+knk= {knk0>0, knk1>0};
+
+% Target spark angle of each operating point:  traditional controller mean over settled cycles
+settled= repmat([false(ceil(dwell/2),1); true(floor(dwell/2),1)],numOps*numVisits,1);
+rec.thetaTarg= zeros(numOps,1);
+for o=1:numOps,
+    rec.thetaTarg(o)= mean(mean(spk{1}(settled & (k==o),:)));
+end;
+
+% Response times and recovery knocks on every re-entry
+rec.T= zeros(numOps,2);
+rec.nk= zeros(numOps,2);
+for c=1:2,
+    for v=2:numVisits,
+        for o=1:numOps,
+            start= ((v-1)*numOps + (o-1))*dwell;               % first cycle of this visit
+            x= spk{c}(start+[0:dwell],:) - rec.thetaTarg(o);    % from the last cycle before entry
+            reached= [false(1,numRuns); (sign(x(2:end,:))~=repmat(sign(x(1,:)),dwell,1)) | (x(2:end,:)==0)];
+            reached(end,:)= true;
+            [~,T]= max(reached,[],1);
+            T= T-1;
+            K= cumsum(knk{c}(start+[1:dwell],:),1);
+            rec.T(o,c)= rec.T(o,c) + mean(T)/(numVisits-1);
+            rec.nk(o,c)= rec.nk(o,c) + mean(K(T+dwell*[0:numRuns-1]))/(numVisits-1);
+        end;
+    end;
+end;
+rec.meanT= mean(rec.T,1);
+rec.meanNk= mean(rec.nk,1);
+rec.reductionT= 1 - rec.meanT(2)/rec.meanT(1);
+rec.reductionNk= 1 - rec.meanNk(2)/rec.meanNk(1);
+rec.time= time/(n*numRuns);
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=8) && ~isempty(fig)),
+    figure, plot([0:n-1],mean(spk{1},2),[0:n-1],mean(spk{2},2));
+    xlabel('Cycle number [-]');
+    ylabel('Mean relative spark angle [deg]');
+    legend('Traditional','Borderline learning');
+end;
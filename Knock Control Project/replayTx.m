@@ -0,0 +1,127 @@
+function [rp,mask]= replayTx(xi,Tx,win,truth,fig)
+
+% replayTx Bit-sliced replay of up to 64 knock thresholds over knock intensity traces
+%
+% Syntax
+% [rp,mask]= replayTx(xi,Tx)
+% [rp,mask]= replayTx(xi,Tx,win)
+% [rp,mask]= replayTx(xi,Tx,win,truth)
+% [rp,mask]= replayTx(xi,Tx,win,truth,fig)
+%
+% Description
+% |[rp,mask]= replayTx(xi,Tx)| applies up to 64 knock intensity thresholds |Tx| at once to the
+% |[numCycles x numCyl]| knock intensity traces |xi|, (eg. one experiment of a spark sweep, see
+% eCdf, or the intensity output of simKnk with one column per run).  The rows of |Tx| are the
+% different thresholds, and its columns are cylinder specific, (the same thresholds are applied to
+% all cylinders if there is only one column), as in knockP.
+%
+% The number of thresholds exceeded by each cycle is found in one pass over the traces of each
+% cylinder, by locating each intensity among the sorted thresholds of that cylinder, (with histc).
+% A cycle exceeds threshold |k| if and only if this count is at least the rank of |Tx(k,cyl)|
+% among the thresholds of that cylinder, so the counts for every threshold, cylinder and window
+% are obtained from a single histogram of the counts, without a separate pass over the traces for
+% each threshold.  The comparisons are also returned packed into the |uint64| bit mask 
+% |mask(cycle,cyl)|, in which bit |k| is set if the intensity exceeds threshold |Tx(k,cyl)|, (so 
+% that the count is the number of set bits, see popCount), looked up from the count.
+%
+% The output structure |rp| contains the fields |knocks| and |rate|, |[numTx x numCyl x numWin]|
+% arrays of the number of knock events and the knock probability for each threshold, cylinder
+% and window, and |cycles|, the number of cycles in each window.
+%
+% |[rp,mask]= replayTx(xi,Tx,win)| divides the traces into consecutive windows of |win| cycles,
+% (the last window may be shorter).  By default the whole trace is a single window.
+%
+% |[rp,mask]= replayTx(xi,Tx,win,truth)| also counts the misclassifications of each threshold with
+% respect to the logical |[numCycles x numCyl]| reference classification |truth|, (eg. true for the
+% cycles of an advanced spark experiment and false for the cycles of the borderline experiment, as
+% in optTx).  The additional fields |falseAlarms| (knock detected but |truth| false), |missed|
+% (|truth| true but no knock detected) and |misclass| (their sum) have the same size as |knocks|.
+%
+% |replayTx(-)| with no left hand arguments, or |replayTx(-,'Fig')| with specified input |'Fig'|,
+% plots the knock probability, (and misclassification probability if |truth| is given), of the
+% first window against threshold, for each cylinder.
+%
+% Examples
+% Tx= linspace(0.5,3,64)';                                % 64 candidate thresholds
+% rp= replayTx(xi{BLindx},Tx,1000);                       % Knock rates per 1000 cycle window
+% xAll= [xi{BLindx}; xi{BLindx+2}];                       % BL and BL+2 experiments...
+% truth= [false(size(xi{BLindx})); true(size(xi{BLindx+2}))];
+% rp= replayTx(xAll,Tx,[],truth,'Fig');                   % ...misclassification of every threshold
+% [~,~,~,intensity]= simKnk(1e4,ctl,plant,100);          % Simulated closed loop intensities
+% rp= replayTx(intensity(2:end,:),Tx);                    % ...replayed against all thresholds
+%
+% See also
+% popCount optTx knockP simKnk
+
+
+% Check input arguments
+[numCycles,numCyl]= size(xi);
+if (nargin<3)||isempty(win), win= numCycles; end;
+if (nargin<4), truth= []; end;
+numTx= size(Tx,1);
+if numTx>64, error('At most 64 thresholds can be replayed at once'); end;
+if size(Tx,2)==1, Tx= repmat(Tx,1,numCyl); end;
+if size(Tx,2)~=numCyl,
+    error('Tx must have one column, or one column per column of xi');
+end;
+
+% Number of thresholds exceeded by each cycle, from its place among the sorted thresholds, (the
+% count of Tx<xi is numTx less the count of -Tx<=-xi), and the comparison masks
+[sTx,ord]= sort(Tx,1);
+c= zeros(numCycles,numCyl);
+mask= zeros(numCycles,numCyl,'uint64');
+for jc=1:numCyl,
+    [~,b]= histc(-xi(:,jc),[-inf; -sTx(end:-1:1,jc); inf]);
+    b((b==0)|(b>numTx+1))= numTx+1;                % NaN intensities exceed no threshold
+    c(:,jc)= numTx+1-b;
+    lut= zeros(numTx+1,1,'uint64');                % lut(r+1)= bits of the r lowest thresholds
+    for r=1:numTx,
+        lut(r+1)= bitor(lut(r),bitshift(uint64(1),ord(r,jc)-1));
+    end;
+    mask(:,jc)= lut(c(:,jc)+1);
+end;
+
+% Histogram of the counts for each window, cylinder, (and reference class)
+numWin= ceil(numCycles/win);
+w= repmat(ceil([1:numCycles]'/win),1,numCyl);
+j= repmat([1:numCyl],numCycles,1);
+t= ones(numCycles,numCyl);
+if ~isempty(truth), t= 1 + (truth~=0); end;
+H= accumarray([w(:) j(:) c(:)+1 t(:)],1,[numWin numCyl numTx+1 2]);
+G= cumsum(H(:,:,end:-1:1,:),3);
+G= G(:,:,end:-1:1,:);                              % G(:,:,r+1,:)= cycles exceeding r thresholds
+
+% Counts for each threshold, from its rank among the thresholds of its cylinder
+rp.knocks= zeros(numTx,numCyl,numWin);
+rp.falseAlarms= zeros(numTx,numCyl,numWin);
+rp.missed= zeros(numTx,numCyl,numWin);
+for jc=1:numCyl,
+    rnk(ord(:,jc))= [1:numTx];
+    for k=1:numTx,
+        g= squeeze(G(:,jc,rnk(k)+1,:));
+        if numWin==1, g= g(:)'; end;
+        rp.knocks(k,jc,:)= sum(g,2);
+        rp.falseAlarms(k,jc,:)= g(:,1);
+        rp.missed(k,jc,:)= squeeze(sum(H(:,jc,:,2),3)) - g(:,2);
+    end;
+end;
+rp.cycles= min(win,numCycles-win*[0:numWin-1]');
+rp.rate= bsxfun(@rdivide,rp.knocks,reshape(rp.cycles,1,1,numWin));
+if isempty(truth),
+    rp= rmfield(rp,{'falseAlarms','missed'});
+else
+    rp.misclass= rp.falseAlarms + rp.missed;
+end;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=5) && ~isempty(fig)),
+    figure, plot(Tx,rp.rate(:,:,1),'.-');
+    xlabel('Knock threshold');
+    ylabel('Knock probability');
+    if ~isempty(truth),
+        figure, plot(Tx,rp.misclass(:,:,1)/rp.cycles(1),'.-');
+        xlabel('Knock threshold');
+        ylabel('Misclassification probability');
+    end;
+end;
@@ -0,0 +1,110 @@
+/*
+ * knRing.h  Lock-free single producer / single consumer ring buffer
+ *
+ * A fixed capacity (power of two) ring of fixed size records, shared between exactly one
+ * producer thread and one consumer thread.  The producer owns 'head' and the consumer owns
+ * 'tail'; each is published with release ordering and read with acquire ordering, so no locks
+ * are needed on the data path.  The two indices live on separate cache lines, and each side
+ * keeps a private copy of the other side's index so that it only touches the shared line when
+ * the ring looks full (producer) or empty (consumer).
+ *
+ * In blocking mode the consumer sleeps on a semaphore that the producer posts after every push,
+ * instead of spinning; the ring itself is the same in both modes.
+ */
+
+#ifndef KNRING_H
+#define KNRING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+
+#define KN_CACHE_LINE 64
+
+typedef struct {
+    _Alignas(KN_CACHE_LINE) atomic_size_t head;     /* next slot to write (producer) */
+    size_t tailCache;                               /* producer's copy of tail */
+    _Alignas(KN_CACHE_LINE) atomic_size_t tail;     /* next slot to read (consumer) */
+    size_t headCache;                               /* consumer's copy of head */
+    _Alignas(KN_CACHE_LINE) size_t mask;            /* capacity-1 */
+    size_t recSize;                                 /* bytes per record */
+    int blocking;                                   /* consumer sleeps on 'items' */
+    sem_t items;
+    unsigned char *buf;
+} KnRing;
+
+/* Initialize a ring of at least 'capacity' records of 'recSize' bytes.  Returns 0 on success. */
+static inline int knRingInit(KnRing *r, size_t capacity, size_t recSize, int blocking)
+{
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+    memset(r, 0, sizeof(*r));
+    r->buf = aligned_alloc(KN_CACHE_LINE, ((cap*recSize + KN_CACHE_LINE-1)/KN_CACHE_LINE)*KN_CACHE_LINE);
+    if (!r->buf) return -1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->mask = cap-1;
+    r->recSize = recSize;
+    r->blocking = blocking;
+    return sem_init(&r->items, 0, 0);
+}
+
+static inline void knRingFree(KnRing *r)
+{
+    sem_destroy(&r->items);
+    free(r->buf);
+}
+
+/* Producer:  append one record.  Returns 0, or -1 if the ring is full. */
+static inline int knRingPush(KnRing *r, const void *rec)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - r->tailCache > r->mask) {
+        r->tailCache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head - r->tailCache > r->mask) return -1;
+    }
+    memcpy(r->buf + (head & r->mask)*r->recSize, rec, r->recSize);
+    atomic_store_explicit(&r->head, head+1, memory_order_release);
+    if (r->blocking) sem_post(&r->items);
+    return 0;
+}
+
+/* Consumer:  remove one record without waiting.  Returns 0, or -1 if the ring is empty. */
+static inline int knRingTryPop(KnRing *r, void *rec)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail == r->headCache) {
+        r->headCache = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail == r->headCache) return -1;
+    }
+    memcpy(rec, r->buf + (tail & r->mask)*r->recSize, r->recSize);
+    atomic_store_explicit(&r->tail, tail+1, memory_order_release);
+    return 0;
+}
+
+/* Consumer:  remove one record, spinning (busy-poll mode) or sleeping (blocking mode) until one
+ * is available, or until *stop becomes nonzero.  Returns 0, or -1 if stopped. */
+static inline int knRingPop(KnRing *r, void *rec, const atomic_int *stop)
+{
+    if (r->blocking) {
+        while (sem_wait(&r->items) != 0) ;
+        return knRingTryPop(r, rec);            /* a post without a record means stop */
+    }
+    while (knRingTryPop(r, rec) != 0) {
+        if (atomic_load_explicit(stop, memory_order_relaxed)) return -1;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    return 0;
+}
+
+/* Wake a blocked consumer so that it can observe a stop request. */
+static inline void knRingWake(KnRing *r)
+{
+    if (r->blocking) sem_post(&r->items);
+}
+
+#endif
@@ -0,0 +1,178 @@
+function [out,timing,stats]= schedKnk(jobs,grain,fileName)
+
+% schedKnk Dynamically load balanced execution of heterogeneous simulation and analysis jobs
+%
+% Syntax
+% [out,timing,stats]= schedKnk(jobs)
+% [out,timing,stats]= schedKnk(jobs,grain)
+% [out,timing,stats]= schedKnk(jobs,grain,fileName)
+%
+% Description
+% |[out,timing,stats]= schedKnk(jobs)| evaluates the jobs in the structure array |jobs|, each of
+% which is a call |[out{j}{1:nout}]= jobs(j).fcn(jobs(j).args{:})|, splitting large jobs into
+% smaller tasks and executing the tasks on the workers of the open parallel pool, (or serially if
+% no pool is open).  The fields of each job are:
+%   |fcn|       function handle, eg. |@simKnk|, |@pdfKnk|, |@pdfSpk|
+%   |args|      cell array of input arguments
+%   |nout|      number of outputs required, (default 1)
+%   |cost|      estimated cost, in any consistent unit such as flops, (default 1)
+%   |split|     index of the argument along which the job may be split, (default 0, not split)
+%   |splitKind| how the split argument is divided, (default |'runs'|):  |'runs'| if it is a
+%               number of Monte Carlo runs, (eg. |numRuns| of simKnk), which is divided into run
+%               ranges, or |'elements'| if it is an array, (of any length, including one), which
+%               is divided into blocks of elements.  The latter is only useful if the work, and
+%               the outputs, of each element are independent of the others, (not eg. pdfKnk, 
+%               which computes every state whatever |myAngles|, or pdfSpk, whose cycle vector
+%               must start from zero)
+%   |seedArg|   index of the random number seed argument, if any, so that task |i| of the job
+%               uses substream |i| of the 'mrg32k3a' stream, |[seed(1) i]|, as simKnk, pairKnk
+%               and bootKnk, (default 0)
+%   |catDim|    dimension along which the outputs of the tasks of a job are concatenated,
+%               (default 2, eg. the runs of simKnk, or the angles of pdfKnk)
+%
+% Each job is split into about |cost/grain| tasks, (limited by the size of its split argument),
+% where the target task cost |grain| defaults to 1/64 of the total cost, so that the task
+% decomposition, and hence the results, do not depend on the number of workers.  The tasks are
+% queued in order of decreasing cost, and every worker takes the next task from the shared
+% queue as soon as it finishes the last, so that the workers stay busy until the queue is empty,
+% and the small tasks at the end of the queue fill the gaps left by the large ones.
+%
+% Output |out{j}| is a cell array of the |nout| outputs of job |j|.  Output |timing| is a structure
+% array with one element per task and fields |job|, |task|, |worker|, |start| and |time|, (the
+% start time relative to the start of the schedule, and the execution time, in seconds), and
+% |cost|.  Output |stats| contains the |makespan|, the total |busy| time, the |efficiency|
+% |busy/(makespan*numWorkers)|, |numWorkers| and |numTasks|.
+%
+% |[out,timing,stats]= schedKnk(jobs,grain,fileName)| also writes |timing| as comma separated
+% values to |fileName|.
+%
+% Examples
+% jobs(1)= struct('fcn',@pdfSpk,'args',{{inf,M400,0,theta400,pCurve400}},'nout',1,'cost',400^3,...
+%                 'split',0,'splitKind',[],'seedArg',0,'catDim',2);
+% jobs(2)= struct('fcn',@pdfKnk,'args',{{1e4,Madv,Mret,theta,myAngles}},'nout',1,'cost',1e4^2*6000,...
+%                 'split',0,'splitKind',[],'seedArg',0,'catDim',1);        % not split
+% jobs(3)= struct('fcn',@simKnk,'args',{{1e4,ctl,plant,1e5,1}},'nout',2,'cost',50*1e4*1e5,...
+%                 'split',4,'splitKind','runs','seedArg',5,'catDim',2);    % split into run ranges
+% parpool;
+% [out,timing,stats]= schedKnk(jobs,[],'timing.csv');
+%
+% See also
+% benchKnk simKnk pdfKnk pdfSpk
+
+
+% Check input arguments
+numJobs= length(jobs);
+defaults= {'nout',1; 'cost',1; 'split',0; 'splitKind','runs'; 'seedArg',0; 'catDim',2};
+for i=1:size(defaults,1),
+    if ~isfield(jobs,defaults{i,1}), [jobs.(defaults{i,1})]= deal([]); end;
+    for j=1:numJobs,
+        if isempty(jobs(j).(defaults{i,1})), jobs(j).(defaults{i,1})= defaults{i,2}; end;
+    end;
+end;
+if (nargin<2)||isempty(grain), grain= sum([jobs.cost])/64; end;
+
+% Split the jobs into tasks
+task= struct('job',{},'task',{},'args',{},'cost',{});
+for j=1:numJobs,
+    s= jobs(j).split;
+    numTasks= 1;
+    if s>0,
+        x= jobs(j).args{s};
+        byRuns= strcmp(jobs(j).splitKind,'runs');
+        if byRuns,
+            if ~isscalar(x) || (x<0) || (x~=round(x)),
+                error('The split argument of job %d must be a number of runs, or its splitKind ''elements''',j);
+            end;
+            maxTasks= x;
+        elseif strcmp(jobs(j).splitKind,'elements'), maxTasks= numel(x);
+        else error('The splitKind of job %d must be ''runs'' or ''elements''',j);
+        end;
+        numTasks= max(1,min(maxTasks,ceil(jobs(j).cost/grain)));
+    end;
+    if numTasks==1,
+        task(end+1)= struct('job',j,'task',1,'args',{jobs(j).args},'cost',jobs(j).cost);
+        continue;
+    end;
+    edges= round(linspace(0,maxTasks,numTasks+1));
+    for i=1:numTasks,
+        args= jobs(j).args;
+        if byRuns, args{s}= edges(i+1)-edges(i);
+        else args{s}= x(edges(i)+1:edges(i+1));
+        end;
+        if jobs(j).seedArg>0, args{jobs(j).seedArg}= [args{jobs(j).seedArg}(1) i]; end;
+        task(end+1)= struct('job',j,'task',i,'args',{args},'cost',jobs(j).cost*(edges(i+1)-edges(i))/maxTasks);
+    end;
+end;
+[~,order]= sort([task.cost],'descend');
+task= task(order);
+numTasks= length(task);
+
+% Execute the tasks, largest first, from a shared queue
+pool= [];
+if exist('gcp','file'), pool= gcp('nocreate'); end;
+res= cell(numTasks,1);
+t0= now*86400;
+if isempty(pool),
+    numWorkers= 1;
+    for k=1:numTasks,
+        res{k}= runTask(jobs(task(k).job).fcn,task(k).args,jobs(task(k).job).nout);
+    end;
+else
+    numWorkers= pool.NumWorkers;
+    F(numTasks)= parallel.FevalFuture;
+    for k=1:numTasks,
+        F(k)= parfeval(pool,@runTask,1,jobs(task(k).job).fcn,task(k).args,jobs(task(k).job).nout);
+    end;
+    for i=1:numTasks,
+        [k,r]= fetchNext(F);
+        res{k}= r;
+    end;
+end;
+
+% Assemble the outputs of each job, in task order
+out= cell(numJobs,1);
+for j=1:numJobs,
+    k= find([task.job]==j);
+    [~,i]= sort([task(k).task]);
+    k= k(i);
+    out{j}= cell(1,jobs(j).nout);
+    for o=1:jobs(j).nout,
+        parts= cellfun(@(r) r.out{o},res(k),'UniformOutput',false);
+        out{j}{o}= cat(jobs(j).catDim,parts{:});
+    end;
+end;
+
+% Per task timing
+timing= struct('job',{task.job},'task',{task.task},'worker',cellfun(@(r) r.worker,res,'UniformOutput',false)',...
+               'start',cellfun(@(r) r.start-t0,res,'UniformOutput',false)',...
+               'time',cellfun(@(r) r.time,res,'UniformOutput',false)','cost',{task.cost});
+stats.makespan= max([timing.start]+[timing.time]);
+stats.busy= sum([timing.time]);
+stats.efficiency= stats.busy/(stats.makespan*numWorkers);
+stats.numWorkers= numWorkers;
+stats.numTasks= numTasks;
+if (nargin>=3) && ~isempty(fileName),
+    fid= fopen(fileName,'w');
+    fprintf(fid,'job,task,worker,start,time,cost\n');
+    for k=1:numTasks,
+        fprintf(fid,'%d,%d,%d,%.6f,%.6f,%g\n',timing(k).job,timing(k).task,timing(k).worker,...
+                timing(k).start,timing(k).time,timing(k).cost);
+    end;
+    fclose(fid);
+end;
+
+
+
+function r= runTask(fcn,args,nout)
+
+% Evaluate one task, recording the worker, start time and execution time
+r.worker= 0;
+if exist('getCurrentTask','file'),
+    w= getCurrentTask();
+    if ~isempty(w), r.worker= w.ID; end;
+end;
+r.start= now*86400;
+tic;
+r.out= cell(1,nout);
+[r.out{:}]= fcn(args{:});
+r.time= toc;
@@ -0,0 +1,186 @@
+function sens= sensKnk(pCurve,pCurve_High,gains,theta,recov,thresh,fig)
+
+% sensKnk Adjoint sensitivities of steady state knock control metrics to the gains, knock probabilities and threshold
+%
+% Syntax
+% sens= sensKnk(pCurve,pCurve_High,gains,theta)
+% sens= sensKnk(pCurve,pCurve_High,gains,theta,recov)
+% sens= sensKnk(pCurve,pCurve_High,gains,theta,recov,thresh)
+% sens= sensKnk(pCurve,pCurve_High,gains,theta,recov,thresh,fig)
+%
+% Description
+% |sens= sensKnk(pCurve,pCurve_High,gains,theta)| returns the values and gradients of the steady
+% state mean spark angle, the steady state mean knock probability, and the expected number of
+% knock events during recovery to the steady state, for a traditional knock controller with knock
+% probability curves |pCurve| and |pCurve_High|, (which may be empty |[]| for a single level
+% controller), controller gains |gains= [m1 m2 m1_High m2_High]|, and spark angles |theta|, (see
+% markovMx).  Instead of rebuilding markovMx and pdfSpk(inf) for every finite difference step,
+% the gradients with respect to all the parameters are found together from one sparse linear
+% solve for the steady state pdf and one adjoint solve, (and one more of each for the recovery
+% knocks), so that they cost about as much as a single evaluation of the metrics.
+%
+% The output structure |sens| contains the steady state pdf |sens.Pinf|, and the sub-structures
+% |sens.spk|, |sens.knock| and |sens.nk| for the three metrics, each with the fields:
+%   |value|     the value of the metric
+%   |dp|        the gradient with respect to each entry of |pCurve|, |[numStates x 1]|
+%   |dpH|       the gradient with respect to each entry of |pCurve_High|, (zero if not used)
+%   |dgains|    the gradient with respect to |gains|, |[1 x 4]|, in units per state step.  The
+%               gains are treated as continuous, with a fractional step shared between the two
+%               neighbouring states, and the derivative is the one-sided derivative for an
+%               increasing step.  The |m1_High| entry is zero since, as in markovMx, |m1_High| does
+%               not enter |M|
+%   |dTx|       the gradient with respect to the knock threshold(s) |thresh.Tx|, (if given)
+%
+% |sens= sensKnk(pCurve,pCurve_High,gains,theta,recov)| specifies |recov= [initSpk thetaTarg]|,
+% the initial spark angle and target spark angle of the recovery transient, with the same
+% definition as |nk| of respT, (default: from the most advanced state |theta(end)| to the steady
+% state mean spark angle).  The target state is held fixed when differentiating.
+%
+% |sens= sensKnk(pCurve,pCurve_High,gains,theta,recov,thresh)| also returns the gradients with
+% respect to the knock thresholds, given a structure |thresh| with fields |Tx|, (the threshold,
+% or |[Tx; Tx_High]| for a two level controller), |cdfData| and |cyl|, (default 1), from which
+% |pCurve= knockP(Tx(1),cdfData,cyl,theta)| was computed, (see knockP).  If the high intensity
+% curve was computed from separately normalized cdfs, as |myCdf_High| in plotDriver, these are
+% given by the field |cdfData_High|, (default |cdfData|), so that |pCurve_High=
+% knockP(Tx(2),cdfData_High,cyl,theta)|.  The derivative of the knock probability curve with
+% respect to each threshold is found by a central difference of knockP, which does not involve
+% the Markov chain.  Since the empirical cdf is piecewise linear between its order statistics,
+% (see x2p), a small step would return the slope of a single segment, which is arbitrarily steep
+% between nearly repeated intensities, (see eCdf).  The step is therefore chosen to span the
+% |thresh.numOrd| order statistics, (default 10), on either side of the threshold in every
+% experiment, so that |dTx| is the slope of the cdf smoothed over that window, a usable descent
+% direction but not an exact derivative.
+%
+% |sensKnk(-)| with no left hand arguments, or |sensKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the gradients of the three metrics with respect to the knock probability curve.
+%
+% Examples
+% myPcurve1= knockP(tradTx,myCdf,1,theta1);
+% thresh= struct('Tx',tradTx(1),'cdfData',myCdf,'cyl',1);
+% sens= sensKnk(myPcurve1,[],[m1 m2],theta1,[],thresh,'Fig');
+% newTx= tradTx(1) - 0.1*sens.knock.dTx;                   % eg. a gradient step on the threshold
+%
+% thresh= struct('Tx',[tradTx; tradTx_High],'cdfData',myCdf,'cdfData_High',myCdf_High,'cyl',1);
+% sens= sensKnk(myPcurve1,myPcurve1_High,[m1 m2 m1_High m2_High],theta1,[],thresh);
+%
+% See also
+% markovMx pdfSpk respT knockP optTx
+
+
+% Check input arguments
+if length(gains)<4, gains(3:4)= gains(1:2); end;
+theta= theta(:);
+p= pCurve(:);
+numStates= length(p);
+pH= zeros(numStates,1);
+if ~isempty(pCurve_High), pH= pCurve_High(:); end;
+
+% Sparse transition matrix, (as markovMx, indexed from zero), and the states reached by a
+% unit increase of each gain
+imax= numStates-1;
+i= [0:imax]';
+ix.adv= i + min(gains(1),imax-i) + 1;
+ix.ret= i - min(gains(2),i) + 1;
+ix.retH= i - min(gains(4),i) + 1;
+ix.advS= ix.adv + (i+gains(1)<imax);
+ix.retS= ix.ret - (i-gains(2)>0);
+ix.retHS= ix.retH - (i-gains(4)>0);
+M= sparse([i; i; i]+1,[ix.adv; ix.ret; ix.retH],[1-p; p-pH; pH],numStates,numStates);
+I= speye(numStates);
+e= ones(numStates,1);
+
+% Steady state pdf, Pinf'*M= Pinf' with sum(Pinf)= 1
+x= [I-M', e; e', 0] \ [zeros(numStates,1); 1];
+Pinf= x(1:numStates);
+sens.Pinf= Pinf;
+
+% Adjoints of the steady state metrics c'*Pinf, (dJ/dM(i,j)= Pinf(i)*g(j) where (I-M)*g= c-J, Pinf'*g= 0)
+c= [theta p];
+g= [I-M, e; Pinf', 0] \ [c; 0 0];
+g= g(1:numStates,:);
+sens.spk.value= theta'*Pinf;
+[sens.spk.dp,sens.spk.dpH,sens.spk.dgains]= chainGrad(Pinf,g(:,1),[],p,pH,ix);
+sens.knock.value= p'*Pinf;
+[sens.knock.dp,sens.knock.dpH,sens.knock.dgains]= chainGrad(Pinf,g(:,2),[],p,pH,ix);
+sens.knock.dp= sens.knock.dp + Pinf;
+
+% Expected recovery knocks, (as respT), and their adjoint
+if (nargin<5)||isempty(recov), recov= [theta(end) sens.spk.value]; end;
+k= find(theta<recov(2),1,'last')+1;
+i0= find(theta>=recov(1),1,'first');
+[r,cl,v]= find(M);
+kept= keep(r,cl,k);
+A= I - sparse(r(kept),cl(kept),v(kept),numStates,numStates);
+D= p; D(k)= 0;
+nk= A \ D;
+y= A' \ double([1:numStates]'==i0);
+sens.nk.value= nk(i0);
+[sens.nk.dp,sens.nk.dpH,sens.nk.dgains]= chainGrad(y,nk,k,p,pH,ix);
+sens.nk.dp= sens.nk.dp + y.*([1:numStates]'~=k);
+
+% Threshold gradients, by the chain rule through knockP
+if (nargin>=6) && ~isempty(thresh),
+    if ~isfield(thresh,'cyl') || isempty(thresh.cyl), thresh.cyl= 1; end;
+    if ~isfield(thresh,'cdfData_High') || isempty(thresh.cdfData_High), thresh.cdfData_High= thresh.cdfData; end;
+    if ~isfield(thresh,'numOrd') || isempty(thresh.numOrd), thresh.numOrd= 10; end;
+    Tx= thresh.Tx(:);
+    cdfs= {thresh.cdfData, thresh.cdfData_High};
+    dpdTx= zeros(numStates,length(Tx));
+    for j=1:length(Tx),
+        h= ordStep(Tx(j),cdfs{j},thresh.cyl,thresh.numOrd);
+        dpdTx(:,j)= reshape(knockP(Tx(j)+h,cdfs{j},thresh.cyl,theta) ...
+                          - knockP(Tx(j)-h,cdfs{j},thresh.cyl,theta),[],1) / (2*h);
+    end;
+    for f= {'spk','knock','nk'},
+        dTx= sens.(f{1}).dp'*dpdTx(:,1);
+        if length(Tx)>1, dTx(2)= sens.(f{1}).dpH'*dpdTx(:,2); end;
+        sens.(f{1}).dTx= dTx;
+    end;
+end;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=7) && ~isempty(fig)),
+    figure, plot(theta,sens.spk.dp);
+    xlabel('Relative spark angle [deg]');
+    ylabel('d(mean spark angle) / d(knock probability) [deg]');
+
+    figure, plot(theta,sens.knock.dp);
+    xlabel('Relative spark angle [deg]');
+    ylabel('d(mean knock probability) / d(knock probability) [-]');
+
+    figure, plot(theta,sens.nk.dp);
+    xlabel('Relative spark angle [deg]');
+    ylabel('d(recovery knocks) / d(knock probability) [-]');
+end;
+
+
+
+function [dp,dpH,dgains]= chainGrad(u,w,k,p,pH,ix)
+
+% Gradients wrt p, pH and the gains of a metric with dJ/dM(i,j)= u(i)*w(j) for the kept entries of M
+W= @(j) w(j).*keep([1:length(u)]',j,k);
+dp= u.*(W(ix.ret) - W(ix.adv));
+dpH= u.*(W(ix.retH) - W(ix.ret));
+dgains= [sum(u.*(1-p).*(W(ix.advS)-W(ix.adv))), sum(u.*(p-pH).*(W(ix.retS)-W(ix.ret))), ...
+         0, sum(u.*pH.*(W(ix.retHS)-W(ix.retH)))];
+
+
+function K= keep(i,j,k)
+
+% Entries of M retained by respT's absorbing target state k, (all if k is empty)
+K= true(size(i));
+if ~isempty(k), K= ~(((i>=k) & (j<=k)) | ((i<=k) & (j>=k))); end;
+
+
+function h= ordStep(Tx,cdfData,cyl,K)
+
+% Half width of the smallest interval about Tx spanning K order statistics either side of Tx in
+% every experiment, (at least 1e-4*max(abs(Tx),1))
+h= 1e-4*max(abs(Tx),1);
+for k=1:length(cdfData),
+    x= cdfData(k).x(:,cyl);
+    i= find(x<=Tx,1,'last');
+    if isempty(i) || (i==length(x)), continue; end;           % Tx outside the data:  flat cdf
+    h= max(h,max(Tx-x(max(i-K+1,1)),x(min(i+K,length(x)))-Tx));
+end;
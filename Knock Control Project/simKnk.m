@@ -0,0 +1,270 @@
+function [relSpark,knocking,simState,intensity]= simKnk(n,ctl,plant,x0,seed)
+
+% simKnk Monte Carlo closed-loop simulation of a traditional knock controller
+%
+% Syntax
+% [relSpark,knocking,simState]= simKnk(n,ctl,plant)
+% [relSpark,knocking,simState]= simKnk(n,ctl,plant,numRuns)
+% [relSpark,knocking,simState]= simKnk(n,ctl,plant,numRuns,seed)
+% [relSpark,knocking,simState]= simKnk(n,ctl,plant,simState)
+% [relSpark,knocking,simState,intensity]= simKnk(-)
+%
+% Description
+% |[relSpark,knocking,simState]= simKnk(n,ctl,plant)| simulates |n| cycles of the closed loop
+% formed by the knock0.mdl 'Knock Control' law, (see knCtrl), and the 'Knock + Engine Simulator'
+% plant, returning the relative spark angle |relSpark| and knock flags |knocking| at cycles 
+% |[0:n]|.  The plant knocks with probability |p| interpolated, (and extrapolated), from the table
+% |plant.knockGenP| at the breakpoints |plant.knockGenTheta|, and its knock flag is applied to the
+% controller on the following cycle.  The controller parameters are given by |ctl|, (see knCtrl), 
+% where |spkMin= -3| and |spkMax= 2| are assumed if not specified, as in knock0.mdl.
+%
+% If the breakpoints |plant.knockGenTheta| are uniformly spaced, (as for a Delta grid), the
+% knock probability look-up is made by direct indexing with precomputed slopes, rather than by a
+% search of the breakpoints, and spark angles that lie on a breakpoint read the table value
+% exactly.  The look-up table is constructed once, and stored as |plant.lut|.
+%
+% Cycle 0 is the initial state |relSpark= ctl.initialSpark|, and a knock may occur there, as in the 
+% Markov chain analysis of pdfSpk and pdfKnk, (whereas knock0.mdl forces no knock on cycle 0). 
+% The number of knock events in the first |n| cycles is therefore |sum(knocking(1:n,:))|.  If 
+% |plant.knockGenP_High| is also given, |knocking| is the knock level 0,1,2 where level 2 (high 
+% intensity) knock events occur with probability |knockGenP_High| and are retarded by 
+% |ctl.retardGain_High|, as in markovMx.
+%
+% |[relSpark,knocking,simState]= simKnk(n,ctl,plant,numRuns,seed)| simulates |numRuns| independent 
+% runs simultaneously, so that |relSpark| and |knocking| are |[(n+1) x numRuns]| matrices.  The 
+% random numbers are drawn from a 'mrg32k3a' RandStream with the specified |seed|, (default 0), 
+% so results are reproducible.  If |seed= [seed substream]|, the random numbers are drawn from
+% that substream of the stream, (a fixed offset of 2^127 numbers per substream), so that
+% independent blocks of runs, or common random numbers for different controllers, can be indexed
+% by substream number without reseeding, (see pairKnk).
+%
+% Output |simState| contains the complete controller, plant delay and random number generator 
+% state at cycle |n|, and |[relSpark,knocking,simState]= simKnk(n,ctl,plant,simState)| continues the 
+% simulation from that state.  A simulation of |n1| cycles continued for |n2| cycles reproduces a 
+% single simulation of |n1+n2| cycles exactly.
+%
+% The controller runs in the data type of the |ctl| parameters, (see castCtl), with the plant
+% breakpoints |plant.knockGenTheta| given in the same (eg. Q-format) units.
+%
+% For a drive cycle with a time-varying operating point, the plant may instead be given by an
+% operating point map |plant.map|, (see opMap), and the speed and load at each cycle,
+% |plant.speed| and |plant.load|, (the last values being held beyond the end of the trace).  The
+% knock probability is then looked up from the map with opKnockP on every cycle, and if
+% |plant.highTarg| is given, the high intensity knock probability is taken from that threshold
+% of the map.
+%
+% For an intensity level plant, |plant.cdfData| is the empirical cdf data of a spark sweep, (see
+% eCdf), and the plant produces a knock intensity on every cycle, sampled by inverse transform of
+% the cdf of cylinder |plant.cyl|, (default 1), as in p2x, with the quantiles of the two adjacent
+% sweep points |[plant.cdfData.theta]| mixed linearly in spark angle, (and held beyond them).  The knock
+% threshold |ctl.Tx|, (and |ctl.Tx_High| for the two level controller), must then be given, and
+% the intensities are thresholded in the loop, so that any threshold can be simulated without
+% recomputing knock probability curves with knockP.  |knocking| remains the knock flag, (or knock
+% level), and the additional output |intensity| contains the |[(n+1) x numRuns]| intensities,
+% (empty for a knock probability plant, and NaN on cycle 0 of a continued simulation, whose
+% intensity is the last one returned by the previous simulation).  If |plant.alias| is given
+% instead, the intensities of cylinder |plant.cyl| are drawn in constant time from the alias
+% table of aliasCdf, (see aliasRand), with the same quantile mixing, so the two plants are
+% interchangeable.
+%
+% If |ctl.learnGain| is given, the adaptive borderline learning controller knLearn is used in
+% place of knCtrl, with the speed/load cells |ctl.cellSpeed| and |ctl.cellLoad|, (default the
+% breakpoints of |plant.map|), so that each run restores the spark angle learned in a cell when
+% the drive cycle re-enters it.  The cell of each cycle is the nearest cell to the drive cycle
+% operating point, and the learning state is held in |simState.learn|, (see knLearn).
+%
+% Examples
+% ctl= struct('initialSpark',-1.6,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3,'spkMax',2);
+% plant= struct('knockGenTheta',theta,'knockGenP',myPcurve1);
+% [relSpark,knocking]= simKnk(10000,ctl,plant,1000,2000);   % 1000 runs of knock0.mdl
+% plot([0:500],relSpark(1:501,1:2));
+% ctl.Tx= tradTx(1); ctl.Tx_High= p2x(0.995,myCdfn(BLindx),1); ctl.retardGain_High= m2_High*Delta;
+% [relSpark,knocking,~,intensity]= simKnk(10000,ctl,struct('cdfData',myCdfn,'cyl',1),1000);  % Intensity plant
+%
+% See also
+% knCtrl knLearn eCdf p2x aliasCdf pdfSpk pdfKnk
+
+
+% Check input arguments
+if (nargin<4)||isempty(x0), x0= 1; end;
+if (nargin<5)||isempty(seed), seed= 0; end;
+if ~isfield(ctl,'spkMin'), ctl.spkMin= -3; end;
+if ~isfield(ctl,'spkMax'), ctl.spkMax= 2; end;
+learning= isfield(ctl,'learnGain');
+if learning, [ctl,opCells]= cellTrace(ctl,plant); end;
+if isfield(plant,'knockGenTheta') && ~isfield(plant,'lut'), plant= plantLut(plant); end;
+intensityPlant= isfield(plant,'cdfData') || isfield(plant,'alias');
+if intensityPlant && ~isfield(ctl,'Tx'), error('An intensity level plant requires the knock threshold ctl.Tx'); end;
+ctlLaw= rmfield(ctl,intersect(fieldnames(ctl),{'Tx','Tx_High'}));  % the control law acts on the knock flags
+
+% Initialize, or continue from a previous simulation state
+if isstruct(x0),
+    simState= x0;
+    stream= RandStream('mrg32k3a','Seed',simState.seed(1));
+    stream.State= simState.rngState;
+    numRuns= length(simState.relSpk);
+else
+    numRuns= x0;
+    stream= RandStream('mrg32k3a','Seed',seed(1));
+    if length(seed)>1, stream.Substream= seed(2); end;
+    simState.seed= seed;
+    simState.cycle= 0;
+    simState.relSpk= min(max(ctl.initialSpark*ones(numRuns,1),ctl.spkMin),ctl.spkMax);
+    x= knockGen(plant,simState.relSpk,rand(stream,numRuns,1),0);
+    simState.knocking= knockLevel(x,ctl,intensityPlant);
+end;
+if learning && ~isfield(simState,'learn'), simState.learn= []; end;
+
+% Allocate space for the results
+relSpark= zeros(n+1,numRuns);
+knocking= false(n+1,numRuns);
+if ~islogical(simState.knocking), knocking= zeros(n+1,numRuns,'uint8'); end;
+intensity= [];
+if intensityPlant, intensity= NaN(n+1,numRuns); end;
+relSpark(1,:)= simState.relSpk;
+knocking(1,:)= simState.knocking;
+if intensityPlant && ~isstruct(x0), intensity(1,:)= x; end;
+
+% Simulate the closed loop, drawing the random numbers in blocks of cycles
+relSpk= simState.relSpk;
+knk= simState.knocking;
+blockSize= max(1,min(n,floor(2^20/numRuns)));
+for i0= 1:blockSize:n,
+    U= rand(stream,numRuns,min(blockSize,n-i0+1));
+    for j= 1:size(U,2),
+        c= simState.cycle+i0+j-1;
+        if learning,                                    % Knock Control
+            [relSpk,simState.learn]= knLearn(relSpk,knk,opCells(min(c+1,end)),simState.learn,ctlLaw);
+        else
+            relSpk= knCtrl(relSpk,knk,ctlLaw);
+        end;
+        x= knockGen(plant,relSpk,U(:,j),c);             % Knock + Engine Simulator
+        knk= knockLevel(x,ctl,intensityPlant);
+        relSpark(i0+j,:)= relSpk;
+        knocking(i0+j,:)= knk;
+        if intensityPlant, intensity(i0+j,:)= x; end;
+    end;
+end;
+
+% Output the final simulation state
+simState.cycle= simState.cycle + n;
+simState.relSpk= relSpk;
+simState.knocking= knk;
+simState.rngState= stream.State;
+
+
+
+function knk= knockGen(plant,relSpk,u,cycle)
+
+% Knock (level) generated by the plant at spark angles relSpk, given uniform random numbers u
+relSpk= double(relSpk);
+if isfield(plant,'alias'),
+    cyl= 1;
+    if isfield(plant,'cyl'), cyl= find(plant.alias.cyl==plant.cyl); end;
+    knk= aliasRand(plant.alias,relSpk,u,cyl);
+    return;
+end;
+if isfield(plant,'cdfData'),
+    knk= knockIntensity(plant,relSpk,u);
+    return;
+end;
+if isfield(plant,'map'),
+    i= min(cycle+1,length(plant.speed));
+    p= opKnockP(plant.map,plant.speed(i),plant.load(i),relSpk);
+    knk= u<p;
+    if isfield(plant,'highTarg'),
+        pHigh= opKnockP(plant.map,plant.speed(i),plant.load(i),relSpk,plant.highTarg);
+        knk= uint8(knk) + uint8(u<pHigh);
+    end;
+    return;
+end;
+if isfield(plant,'lut'),
+    p= lutP(plant.lut,relSpk);
+    knk= u<p(:,1);
+    if size(p,2)>1, knk= uint8(knk) + uint8(u<p(:,2)); end;
+    return;
+end;
+p= interp1(plant.knockGenTheta,plant.knockGenP,relSpk,'linear','extrap');
+knk= u<p;
+if isfield(plant,'knockGenP_High'),
+    pHigh= interp1(plant.knockGenTheta,plant.knockGenP_High,relSpk,'linear','extrap');
+    knk= uint8(knk) + uint8(u<pHigh);
+end;
+
+
+function knk= knockLevel(x,ctl,intensityPlant)
+
+% Knock flag, (or level), of the plant output x, thresholding the intensities of an intensity plant
+knk= x;
+if ~intensityPlant, return; end;
+if isfield(ctl,'Tx_High'), knk= uint8(x>ctl.Tx) + uint8(x>ctl.Tx_High);
+else knk= x>ctl.Tx;
+end;
+
+
+function plant= plantLut(plant)
+
+% Direct indexing look-up table of the knock probability curve(s), if the breakpoints are uniform
+x= plant.knockGenTheta(:);
+N= length(x);
+if (N<2) || any(abs(diff(x)-(x(2)-x(1)))>1e-9*max(abs(x))+eps), return; end;
+P= plant.knockGenP(:);
+if isfield(plant,'knockGenP_High'), P= [P plant.knockGenP_High(:)]; end;
+plant.lut.x0= x(1);
+plant.lut.invDelta= 1/(x(2)-x(1));
+plant.lut.maxIndex= N-1;
+plant.lut.P= P;
+plant.lut.S= [diff(P,1,1); P(N,:)-P(N-1,:)];            % slope from each breakpoint, (extrapolated)
+
+
+function p= lutP(lut,relSpk)
+
+% Knock probabilities at relSpk:  grid index and fraction, (snapped to exact grid points), and slope
+f= (relSpk(:)-lut.x0)*lut.invDelta;
+r= round(f);
+exact= abs(f-r)<1e-9;
+f(exact)= r(exact);
+i= min(max(floor(f),0),lut.maxIndex);
+p= lut.P(i+1,:) + bsxfun(@times,f-i,lut.S(i+1,:));
+
+
+function [ctl,opCells]= cellTrace(ctl,plant)
+
+% Learning cell index of each cycle of the drive cycle, (a single cell if there is no drive cycle)
+if ~isfield(plant,'map'),
+    ctl.cellSpeed= 0; ctl.cellLoad= 0;
+    opCells= 1;
+    return;
+end;
+if ~isfield(ctl,'cellSpeed'), ctl.cellSpeed= plant.map.speed; end;
+if ~isfield(ctl,'cellLoad'), ctl.cellLoad= plant.map.load; end;
+a= 1; b= 1;
+if numel(ctl.cellSpeed)>1, a= interp1(ctl.cellSpeed(:),[1:numel(ctl.cellSpeed)]',plant.speed(:),'nearest','extrap'); end;
+if numel(ctl.cellLoad)>1, b= interp1(ctl.cellLoad(:),[1:numel(ctl.cellLoad)]',plant.load(:),'nearest','extrap'); end;
+opCells= a + numel(ctl.cellSpeed)*(b-1);
+
+
+function x= knockIntensity(plant,relSpk,u)
+
+% Knock intensity at spark angles relSpk by inverse transform of the eCdf data, given uniform u
+cyl= 1;
+if isfield(plant,'cyl'), cyl= plant.cyl; end;
+thetaE= [plant.cdfData.theta];
+numE= length(thetaE);
+i= ones(size(relSpk));
+f= zeros(size(relSpk));
+if numE>1,
+    f= interp1(thetaE(:),[0:numE-1]',min(max(relSpk,thetaE(1)),thetaE(end)));
+    i= min(floor(f),numE-2);
+    f= f-i;
+    i= i+1;
+end;
+x= zeros(size(relSpk));
+for k=1:numE,
+    lo= i==k;
+    hi= (i+1==k) & (f>0);
+    sel= lo | hi;
+    if ~any(sel), continue; end;
+    w= (1-f(sel)).*lo(sel) + f(sel).*hi(sel);
+    x(sel)= x(sel) + w.*interp1(plant.cdfData(k).Fx,plant.cdfData(k).x(:,cyl),u(sel));
+end;
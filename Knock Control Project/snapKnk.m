@@ -0,0 +1,114 @@
+function out= snapKnk(in)
+
+% snapKnk Compact binary snapshot of a Monte Carlo knock control simulation state
+%
+% Syntax
+% bytes= snapKnk(simState)
+% simState= snapKnk(bytes)
+%
+% Description
+% |bytes= snapKnk(simState)| serializes the simulation state |simState| returned by simKnk, (the 
+% controller state |relSpk|, the knock flags held in the plant's engine delay, the random number 
+% generator state, seed and cycle number, and the learned offsets |learn| of the borderline
+% learning controller, see knLearn), of all of its runs at once, into a single |uint8| row 
+% vector.  The spark angles and learned offsets are stored in their native data type, (see
+% castCtl), and the knock flags and learned cell flags are bit-packed, so a snapshot of |numRuns|
+% double precision runs of the traditional controller takes |8.125*numRuns| bytes plus a fixed
+% header, and can be written with |fwrite| or held in memory for thousands of checkpoints.  The
+% fourth byte of the snapshot is its format version, and snapshots of any other version are
+% rejected.  The whole seed is stored, so a |[seed substream]| state, (see simKnk), is restored
+% with its substream.
+%
+% |simState= snapKnk(bytes)| restores the simulation state from its snapshot, so that
+% |simKnk(n,ctl,plant,snapKnk(snapKnk(simState)))| reproduces |simKnk(n,ctl,plant,simState)| exactly.
+%
+% Examples
+% [~,~,simState]= simKnk(500,ctl,plant,1000,1);       % Warm up 1000 runs
+% bytes= snapKnk(simState);                           % Checkpoint at cycle 500
+% [relSpark,knocking]= simKnk(1000,ctl,plant,snapKnk(bytes));
+% isequal(snapKnk(snapKnk(simState)),simState)        % true, including any seed substream and learn state
+%
+% See also
+% simKnk forkKnk
+
+
+classes= {'double','single','int32','int16'};
+magic= uint8('KNK');
+version= 1;
+if isstruct(in),
+
+    % Serialize:  header, rng state, spark angles, packed knock flags, learning state
+    s= in;
+    numRuns= length(s.relSpk);
+    levels= ~islogical(s.knocking);                             % flags 0, levels 1
+    out= [magic, uint8(version), ...
+          typecast(uint32([numRuns, length(s.rngState), numel(s.seed)]),'uint8'), ...
+          typecast(double([s.cycle, s.seed(:)']),'uint8'), ...
+          uint8([find(strcmp(class(s.relSpk),classes)), levels]), ...
+          typecast(uint32(s.rngState(:)'),'uint8'), ...
+          typecast(s.relSpk(:)','uint8')];
+    out= [out, packBits(bitget(uint8(s.knocking(:)'),1))];
+    if levels==1, out= [out, packBits(bitget(uint8(s.knocking(:)'),2))]; end;
+    if ~isfield(s,'learn'), out= [out, uint8(0)];               % no learning, empty, or learned
+    elseif isempty(s.learn), out= [out, uint8(1)];
+    else
+        numCells= size(s.learn.offset,1);
+        out= [out, uint8(2), ...
+              typecast(uint32(numCells),'uint8'), ...
+              typecast(uint32(s.learn.cell(:)'),'uint8'), ...
+              typecast(s.learn.offset(:)','uint8'), ...
+              packBits(s.learn.valid(:)')];
+    end;
+
+else
+
+    % Deserialize
+    if ~isa(in,'uint8') || (numel(in)<26) || ~isequal(in(1:3),magic), error('Input is not a knock simulation snapshot'); end;
+    in= in(:)';
+    if in(4)~=version, error(['Knock simulation snapshot version ' num2str(in(4)) ' is not supported']); end;
+    hdr= double(typecast(in(5:16),'uint32'));
+    numRuns= hdr(1);
+    hdr2= typecast(in(17:24+8*hdr(3)),'double');
+    out.seed= hdr2(2:end);
+    out.cycle= hdr2(1);
+    i= 25+8*hdr(3);
+    cls= classes{in(i)};
+    levels= in(i+1);
+    i= i+2;
+    out.rngState= typecast(in(i:i+4*hdr(2)-1),'uint32')'; i= i+4*hdr(2);
+    nb= numRuns*numel(typecast(zeros(1,cls),'uint8'));
+    out.relSpk= typecast(in(i:i+nb-1),cls)'; i= i+nb;
+    nk= ceil(numRuns/8);
+    out.knocking= unpackBits(in(i:i+nk-1),numRuns)'; i= i+nk;
+    if levels==1,
+        out.knocking= uint8(out.knocking) + 2*uint8(unpackBits(in(i:i+nk-1),numRuns)'); i= i+nk;
+    end;
+    names= {'seed','cycle','relSpk','knocking','rngState'};
+    if in(i)>0,
+        names= {'seed','cycle','relSpk','knocking','learn','rngState'};
+        out.learn= [];
+        if in(i)==2,
+            numCells= double(typecast(in(i+1:i+4),'uint32')); i= i+5;
+            out.learn.cell= double(typecast(in(i:i+4*numRuns-1),'uint32'))'; i= i+4*numRuns;
+            out.learn.offset= reshape(typecast(in(i:i+nb*numCells-1),cls),numCells,numRuns); i= i+nb*numCells;
+            out.learn.valid= reshape(unpackBits(in(i:i+ceil(numCells*numRuns/8)-1),numCells*numRuns),numCells,numRuns);
+        end;
+    end;
+    out= orderfields(out,names);
+
+end;
+
+
+
+function b= packBits(x)
+
+% Pack a row of 0/1 values into bytes, least significant bit first
+x(end+1:8*ceil(length(x)/8))= 0;
+b= uint8(double(reshape(x,8,[]))' * 2.^[0:7]')';
+
+
+function x= unpackBits(b,n)
+
+% Unpack bytes into a logical row of length n
+x= logical(bitget(repmat(b,8,1),repmat([1:8]',1,length(b))));
+x= x(1:n);
@@ -0,0 +1,216 @@
+function [logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles,method,fig)
+
+% tailKnk Underflow-safe tail probabilities of the number of knock events in n cycles
+%
+% Syntax
+% [logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k)
+% [logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles)
+% [logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles,method)
+% [logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles,method,fig)
+%
+% Description
+% |[logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k)| returns |logTail|, a |[length(theta) x length(k)]|
+% matrix containing the natural logarithm of the tail probability |P(Kn >= k)| that at least |k|
+% knock events occur in the first |n| cycles, for all possible initial spark angle states |theta|,
+% given also the 'advance' and 'retard' state transition matrices, |Madv|, |Mret|.  Unlike pdfKnk,
+% no small probabilities are truncated:  the recursion is carried out in log-space so that tail
+% probabilities remain accurate far below 1e-30.  To include two-level (High) retard events, pass
+% |Mret= M-Madv|.
+%
+% Only the counts |0..max(k)-1| are tracked individually, while all counts |>=max(k)| are lumped into
+% a single absorbing column, so the cost is |O(n*max(k)*numStates)| rather than the |O(n^2*numStates^2)|
+% of pdfKnk.  Output |logPnk| is the corresponding |[length(theta) x (max(k)+1)]| matrix of log
+% probabilities, whose first |max(k)| columns are |log P(Kn=j)|, |j=0..max(k)-1|, and whose last column
+% is |log P(Kn>=max(k))|.
+%
+% |[logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles)| with specified initial spark angles
+% |myAngles| only returns the results for the desired angles.  If |myAngles| is empty,
+% |myAngles= unique(theta)|.
+%
+% |[logTail,logPnk]= tailKnk(n,Madv,Mret,theta,k,myAngles,'saddle')| uses a (lattice corrected)
+% Lugannani-Rice saddlepoint approximation instead of the exact log-space recursion.  The cumulant
+% generating function |K(s)= log(e_i'*(Madv+exp(s)*Mret)^n*1)| is evaluated by scaled sparse
+% matrix-vector products whose cost is linear in |n| and independent of |k|, and which is
+% extrapolated once the scaled iteration has converged, so that very long horizons are cheap.
+% |logPnk| is empty in this case.  The default method is |'exact'|.
+%
+% |tailKnk(-)| with no left hand arguments, or |tailKnk(-,'Fig')| with specified input |'Fig'|,
+% plots |log10 P(Kn >= k)| as a function of |k|.
+%
+% Examples
+% [M,Madv,Mret]= markovMx(myPcurve1,myPcurve1_High,m1,m2,m1_High,m2_High);
+% logTail= tailKnk(1000,Madv,M-Madv,theta1,[1:40],0.7,[],'Fig');     % Exact tails starting at BL+0.7
+% logTail= tailKnk(1e6,Madv,M-Madv,theta1,[9000:500:12000],0,'saddle'); % Saddlepoint, long horizon
+%
+% See also
+% pdfKnk mKnk
+
+
+% Check input arguments
+if any(k~=round(k)), error('Input parameter k should be a vector of integer knock counts'); end;
+if (nargin<7)||isempty(method), method= 'exact'; end;
+numStates= size(Madv,1);
+k= k(:)';
+
+% Determine which initial states are to be output
+if nargin<6,
+    myIndexes= [1:numStates];
+else
+    if isempty(myAngles), myAngles= unique(theta); end;
+    for i=1:length(myAngles), myIndexes(i)= find(theta>=myAngles(i),1,'first'); end;
+end;
+
+switch lower(method),
+    case 'exact',
+        [logTail,logPnk]= exactTail(n,Madv,Mret,k);
+        logTail= logTail(myIndexes,:);
+        logPnk= logPnk(myIndexes,:);
+    case 'saddle',
+        logTail= saddleTail(n,Madv,Mret,k,myIndexes);
+        logPnk= [];
+    otherwise,
+        error('Input parameter method should be either ''exact'' or ''saddle''');
+end;
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=8) && ~isempty(fig)),
+    figure, plot(k,logTail'/log(10),'-o');
+    xlabel(['Number of knock events k in first ' num2str(n) ' cycles']);
+    ylabel('log_{10} P(K_n \geq k)');
+end;
+
+
+
+function [logTail,L]= exactTail(n,Madv,Mret,k)
+
+% Log-space recursion of the knock count pdf, with counts >= max(k) lumped
+numStates= size(Madv,1);
+kmax= max([k,1]);
+[aIdx,aLw]= logRows(Madv);
+[rIdx,rLw]= logRows(Mret);
+L= -inf(numStates,kmax+1);
+L(:,1)= 0;                                            % log(1) => no knock events when n=0
+for i=1:n,
+    S= [-inf(numStates,1), L(:,1:kmax-1), logSumExp(cat(3,L(:,kmax),L(:,kmax+1)))];
+    L= logSumExp(cat(3,logMult(aIdx,aLw,L),logMult(rIdx,rLw,S)));
+end;
+
+% Tail probabilities as log-space suffix sums (no cancellation)
+R= L;
+for j=kmax:-1:1,
+    R(:,j)= logSumExp(cat(3,L(:,j),R(:,j+1)));
+end;
+logTail= zeros(numStates,length(k));
+logTail(:,k>0)= R(:,min(k(k>0),kmax)+1);
+logTail(:,k>n)= -inf;
+
+
+function logTail= saddleTail(n,Madv,Mret,k,myIndexes)
+
+% Locate the saddlepoints on a coarse grid of s, extending it until all k are bracketed
+numStates= size(Madv,1);
+Madv= sparse(Madv); Mret= sparse(Mret);
+h= 0.15;
+s= [-3:h:6];
+K= cgfKnk(n,Madv,Mret,s);
+while (min(K(myIndexes,end)-K(myIndexes,end-1))/h<max(k)) && (s(end)<40),
+    s1= s(end)+[h:h:4];
+    s= [s, s1];
+    K= [K, cgfKnk(n,Madv,Mret,s1)];
+end;
+Kp= gradient(K,h);
+
+[kk,ii]= meshgrid(k,myIndexes);
+sHat= zeros(size(kk));
+for i=1:length(myIndexes),
+    [Kp1,j1]= unique(Kp(myIndexes(i),:));
+    sHat(i,:)= interp1(Kp1,s(j1),k,'linear','extrap');
+end;
+
+% Refine each saddlepoint by Newton iteration on exactly evaluated K, K', K''
+hd= 1e-3;
+rows= ii(:);
+nPairs= numel(sHat);
+for iter=1:3,
+    Ks= cgfKnk(n,Madv,Mret,[sHat(:)-hd; sHat(:); sHat(:)+hd]');
+    Km= Ks(rows + numStates*[0:nPairs-1]');
+    K0= Ks(rows + numStates*(nPairs+[0:nPairs-1]'));
+    Kq= Ks(rows + numStates*(2*nPairs+[0:nPairs-1]'));
+    Kpp= (Kq-2*K0+Km)/hd^2;
+    if iter<3, sHat(:)= sHat(:) - ((Kq-Km)/(2*hd)-kk(:))./Kpp; end;
+end;
+s1= sHat(:);
+
+% Lattice corrected Lugannani-Rice approximation to P(Kn >= k)
+w= sign(s1).*sqrt(max(2*(s1.*kk(:)-K0),0));
+u= (1-exp(-s1)).*sqrt(Kpp);
+P= 0.5*erfc(w/sqrt(2)) - exp(-w.^2/2)/sqrt(2*pi).*(1./w - 1./u);
+nearMean= abs(s1)<1e-4;                               % Normal approx with continuity correction
+z= (s1.*Kpp - 0.5)./sqrt(Kpp);
+P(nearMean)= 0.5*erfc(z(nearMean)/sqrt(2));
+logTail= reshape(log(max(P,realmin)),size(kk));
+
+% Exact limits for k<=0 and k>=n
+logTail(kk<=0)= 0;
+logTail(kk>n)= -inf;
+if any(kk(:)==n),
+    Kn= cgfKnk(n,sparse(size(Madv,1),size(Madv,2)),Mret,0);
+    logTail(kk==n)= Kn(ii(kk==n));
+end;
+
+
+function K= cgfKnk(n,Madv,Mret,s)
+
+% K(i,j)= log(e_i'*(Madv+exp(s(j))*Mret)^n*1), by scaled and extrapolated power iteration
+numStates= size(Madv,1);
+V= ones(numStates,length(s));
+logScale= zeros(1,length(s));
+es= exp(s(:)');
+for i=1:n,
+    V1= Madv*V + bsxfun(@times,Mret*V,es);
+    c= max(V1,[],1);
+    V1= bsxfun(@rdivide,V1,c);
+    logScale= logScale + log(c);
+    if max(max(abs(V1-V)))<1e-14,                     % converged => scale is now the Perron root
+        logScale= logScale + (n-i)*log(c);
+        V= V1;
+        break;
+    end;
+    V= V1;
+end;
+K= bsxfun(@plus,log(V),logScale);
+
+
+function [idx,lw]= logRows(A)
+
+% Padded row-wise (column index, log value) representation of a sparse transition matrix
+numStates= size(A,1);
+[i,j,v]= find(A);
+[i,ord]= sort(i); j= j(ord); v= v(ord);
+cnt= accumarray(i,1,[numStates 1]);
+starts= cumsum([1; cnt(1:end-1)]);
+pos= [1:length(i)]' - starts(i) + 1;
+idx= ones(numStates,max([cnt;1]));
+lw= -inf(numStates,max([cnt;1]));
+idx(sub2ind(size(idx),i,pos))= j;
+lw(sub2ind(size(lw),i,pos))= log(v);
+
+
+function Y= logMult(idx,lw,L)
+
+% log(A*exp(L)) for A in padded row-wise log form
+T= zeros(size(L,1),size(L,2),size(idx,2));
+for c=1:size(idx,2),
+    T(:,:,c)= bsxfun(@plus,L(idx(:,c),:),lw(:,c));
+end;
+Y= logSumExp(T);
+
+
+function Y= logSumExp(T)
+
+% log(sum(exp(T),3)) without overflow or underflow
+m= max(T,[],3);
+m1= m; m1(isinf(m1))= 0;
+Y= m1 + log(sum(exp(bsxfun(@minus,T,m1)),3));
+Y(m==-inf)= -inf;
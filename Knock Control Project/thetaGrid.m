@@ -0,0 +1,115 @@
+function [thetaNU,pCurveNU,indx,cmp]= thetaGrid(theta,pCurve,tolP,hMax,refine,fig)
+
+% thetaGrid Non-uniform controller state grid adapted to the knock probability curve
+%
+% Syntax
+% [thetaNU,pCurveNU,indx]= thetaGrid(theta,pCurve,tolP)
+% [thetaNU,pCurveNU,indx]= thetaGrid(theta,pCurve,tolP,hMax)
+% [thetaNU,pCurveNU,indx,cmp]= thetaGrid(theta,pCurve,tolP,hMax,refine)
+% [thetaNU,pCurveNU,indx,cmp]= thetaGrid(theta,pCurve,tolP,hMax,refine,fig)
+%
+% Description
+% |[thetaNU,pCurveNU,indx]= thetaGrid(theta,pCurve,tolP)| selects a subset |thetaNU= theta(indx)|
+% of the uniform (algorithm resolution) state grid |theta|, which is fine where the knock 
+% probability curve |pCurve| is steep, and coarse where it is flat.  Starting from |theta(1)|, each
+% grid step is the largest power-of-two multiple of the uniform spacing over which no column of 
+% |pCurve| changes by more than |tolP|.  The borderline state |theta=0| and the end states are
+% always retained.  |pCurve| may have several columns, eg. |[myPcurve1 myPcurve1_High]|, in which
+% case |pCurveNU= pCurve(indx,:)| retains them all.
+%
+% |[thetaNU,pCurveNU,indx]= thetaGrid(theta,pCurve,tolP,hMax)| also limits the grid spacing to at
+% most |hMax| degrees, (default |hMax= 0.5|).
+%
+% |[thetaNU,pCurveNU,indx,cmp]= thetaGrid(theta,pCurve,tolP,hMax,refine)| refines the grid until
+% the chain of markovMxNU on it matches that of markovMx on |theta|.  |pCurve| must then be
+% |[pCurve pCurve_High]|, and |refine| is a structure with fields |steps|, the controller steps
+% |[advStep retStep retStep_High]| in degrees, |tol|, the tolerance on each element of 
+% |cmp.maxErr|, and optionally |n| and |theta0|, as in markovMxNU.  While any error exceeds |tol|, 
+% |tolP| and |hMax| are halved and the grid is selected again, ending at worst with the uniform 
+% grid.  |cmp| is the comparison structure of markovMxNU for the returned grid, with the added 
+% fields |tolP| and |hMax|, the values finally used, and |numStates|, the number of states 
+% |[nonUniform uniform]|.
+%
+% The reduction depends on the curve.  For the plotDriver curve, (394 states, |m1=1, m2=99,
+% m2_High=150|), |tolP= 0.002| gives 70 states, but with steady state mean spark angle and knock 
+% probability errors of 0.13 deg and 2.4e-5, and transient errors of 0.24 deg and 6.5e-3.  Its 
+% knock probability is a staircase at the actuator resolution, and the one step advance moves 
+% through each stair in turn, which the split of markovMxNU blurs.  The tolerance 
+% |[0.05 1e-4 0.15 0.01]| is met with 105 states, (3.8 times fewer), but halving the spark angle 
+% tolerances needs 214 states, and any tolerance below about 0.01 deg needs the uniform grid.
+%
+% |thetaGrid(-)| with no left hand arguments, or |thetaGrid(-,'Fig')| with specified input |'Fig'|, 
+% plots the knock probability curve and the selected grid points.
+%
+% Examples
+% [thetaNU,pNU,indx]= thetaGrid(theta,[myPcurve1 myPcurve1_High],0.002);  % Adaptive grid
+% [M,Madv,Mret]= markovMxNU(thetaNU,pNU(:,1),pNU(:,2),m1*Delta,m2*Delta,m2_High*Delta);
+% [ssPn,SSspkStats]= pdfSpk(inf,M,0,theta1(indx),pNU(:,1));           % Actuated angles theta1(indx)
+% refine= struct('steps',[m1 m2 m2_High]*Delta,'tol',[0.05 1e-4 0.15 0.01]);
+% [thetaNU,pNU,indx,cmp]= thetaGrid(theta,[myPcurve1 myPcurve1_High],0.002,[],refine);
+% cmp.numStates                                                         % [105 394] states
+%
+% See also
+% markovMxNU knockP
+
+
+% Check input arguments
+if (nargin<4)||isempty(hMax), hMax= 0.5; end;
+numStates= length(theta);
+indx= selectGrid(theta,pCurve,tolP,hMax);
+
+% Refine the grid until the non-uniform chain meets the tolerance, if required
+cmp= [];
+if (nargin>=5) && ~isempty(refine),
+    if size(pCurve,2)<2, error('pCurve must be [pCurve pCurve_High] to refine the grid'); end;
+    fine= refine;
+    fine.theta= theta;
+    fine.pCurve= pCurve(:,1);
+    fine.pCurve_High= pCurve(:,2);
+    while true,
+        [M,Madv,Mret,cmp]= markovMxNU(theta(indx),pCurve(indx,1),pCurve(indx,2), ...
+                                      refine.steps(1),refine.steps(2),refine.steps(3),fine);
+        if all(cmp.maxErr<=refine.tol) || (length(indx)==numStates), break; end;
+        tolP= tolP/2;
+        hMax= hMax/2;
+        indx= selectGrid(theta,pCurve,tolP,hMax);
+    end;
+    cmp.tolP= tolP;
+    cmp.hMax= hMax;
+    cmp.numStates= [length(indx) numStates];
+end;
+thetaNU= theta(indx);
+pCurveNU= pCurve(indx,:);
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=6) && ~isempty(fig)),
+    figure, plot(theta,pCurve); hold all;
+    plot(thetaNU,pCurveNU,'o');
+    xlabel('Relative spark advance [deg]');
+    ylabel('Knock probability');
+    text(0.1,0.85,[num2str(length(indx)) ' of ' num2str(numStates) ' states'],'units','normalized');
+end;
+
+
+
+function indx= selectGrid(theta,pCurve,tolP,hMax)
+
+% Greedy selection of the largest admissible step from each retained state
+numStates= length(theta);
+Delta= (theta(end)-theta(1))/(numStates-1);
+hMaxIndx= max(1,2^floor(log2(max(1,hMax/Delta))));
+BLindx= find(theta>=0,1,'first');
+indx= 1;
+i= 1;
+while i<numStates,
+    h= hMaxIndx;
+    while (h>1) && ((i+h>numStates) || ...
+                    (max(max(abs(bsxfun(@minus,pCurve(i:i+h,:),pCurve(i,:)))))>tolP)),
+        h= h/2;
+    end;
+    if ~isempty(BLindx) && (i<BLindx) && (i+h>BLindx), h= BLindx-i; end;
+    i= i+h;
+    indx(end+1)= i;
+end;
+indx= indx(:);
@@ -0,0 +1,151 @@
+function xv= xvalKnk(ctl,plant,M,Madv,theta,cycles,numSeeds,numRuns,alpha,fig)
+
+% xvalKnk Cross-validation of the Markov chain analysis against Monte Carlo simulation
+%
+% Syntax
+% xv= xvalKnk(ctl,plant,M,Madv,theta,cycles)
+% xv= xvalKnk(ctl,plant,M,Madv,theta,cycles,numSeeds,numRuns)
+% xv= xvalKnk(ctl,plant,M,Madv,theta,cycles,numSeeds,numRuns,alpha)
+% xv= xvalKnk(ctl,plant,M,Madv,theta,cycles,numSeeds,numRuns,alpha,fig)
+%
+% Description
+% |xv= xvalKnk(ctl,plant,M,Madv,theta,cycles)| simulates the closed loop with simKnk, (see simKnk
+% for the definition of |ctl| and |plant|), and compares the empirical distributions of the
+% controller state and of the number of knock events at each of the specified cycle numbers
+% |cycles|, with those predicted by the Markov chain with state transition matrices |M| and |Madv|
+% on the controller state grid |theta|, (see markovMx), starting from |ctl.initialSpark|.
+% Simulated spark angles are mapped to the nearest state in |theta|.  The chain saturates at the
+% end states, so |theta(1)| and |theta(end)| must equal the spark limits |ctl.spkMin| and
+% |ctl.spkMax| of the simulation, (to within half a grid step), or an error is given.
+%
+% The agreement is assessed by Pearson chi-square goodness-of-fit tests, with adjacent bins pooled
+% until each has an expected count of at least 5, and by |(1-alpha)| confidence intervals on the
+% simulated means.  The output structure |xv| contains |xv.cycles| and the sub-structures |xv.spark|
+% and |xv.knock|, each with fields |chi2|, |dof| and |pValue| (the goodness-of-fit test at each
+% cycle), |meanMC| and |ciMC| (the simulated means and their confidence intervals) and |meanMarkov|
+% (the analytic means).  |xv.pass| is true if no test rejects at the Bonferroni corrected level
+% |alpha/numTests|, and every analytic mean lies within its (Bonferroni corrected) interval, where
+% |xv.numTests= 4*length(cycles)| counts both goodness-of-fit tests and both mean checks at each
+% cycle, so that the overall false rejection rate is at most |alpha|.
+%
+% |xv= xvalKnk(ctl,plant,M,Madv,theta,cycles,numSeeds,numRuns)| simulates |numSeeds| independent
+% blocks of |numRuns| runs, in parallel (parfor) if a pool is open, using seeds |1:numSeeds|.  The
+% defaults are |numSeeds= 8|, |numRuns= 1000|, and |alpha= 0.01|.
+%
+% |xvalKnk(-)| with no left hand arguments, or |xvalKnk(-,'Fig')| with specified input |'Fig'|,
+% plots the simulated and analytic mean spark angle and mean number of knock events vs cycle
+% number, with the simulated confidence bands.
+%
+% Examples
+% ctl= struct('initialSpark',1.6,'retardGain',m2*Delta,'advanceGain',m1*Delta,'spkMin',-3.9,'spkMax',2);
+% plant= struct('knockGenTheta',theta,'knockGenP',myPcurve1);
+% [M,Madv]= markovMx(myPcurve1,0*myPcurve1,m1,m2,m1,m2);
+% xv= xvalKnk(ctl,plant,M,Madv,theta,[10 50 100 230],8,1000,0.01,'Fig');
+%
+% See also
+% simKnk pdfSpk pdfKnk tailKnk
+
+
+% Check input arguments
+if (nargin<7)||isempty(numSeeds), numSeeds= 8; end;
+if (nargin<8)||isempty(numRuns), numRuns= 1000; end;
+if (nargin<9)||isempty(alpha), alpha= 0.01; end;
+if ~isfield(ctl,'spkMin'), ctl.spkMin= -3; end;
+if ~isfield(ctl,'spkMax'), ctl.spkMax= 2; end;
+theta= theta(:);
+cycles= cycles(:)';
+numStates= length(theta);
+if max(abs([theta(1)-ctl.spkMin, theta(end)-ctl.spkMax])) > min(diff(theta))/2,
+    error('The end states theta(1)= %g and theta(end)= %g must equal ctl.spkMin= %g and ctl.spkMax= %g',...
+          theta(1),theta(end),ctl.spkMin,ctl.spkMax);
+end;
+numCycles= length(cycles);
+n= max(cycles);
+numTests= 4*numCycles;                          % 2 goodness-of-fit tests and 2 mean intervals per cycle
+z= sqrt(2)*erfinv(1-alpha/numTests);
+
+% Monte Carlo:  simulate the seed blocks in parallel, keeping only states and counts at 'cycles'
+idxMC= cell(numSeeds,1);
+knkMC= cell(numSeeds,1);
+parfor s=1:numSeeds,
+    [relSpark,knocking]= simKnk(n,ctl,plant,numRuns,s);
+    idxMC{s}= interp1(theta,[1:numStates]',relSpark(cycles+1,:),'nearest','extrap');
+    K= [zeros(1,numRuns); cumsum(knocking(1:n,:)>0,1)];
+    knkMC{s}= K(cycles+1,:);
+end;
+idxMC= [idxMC{:}];
+knkMC= [knkMC{:}];
+R= size(idxMC,2);
+
+% Markov chain:  spark state pdfs and knock event pdfs at 'cycles'
+i0= interp1(theta,[1:numStates]',min(max(ctl.initialSpark,ctl.spkMin),ctl.spkMax),'nearest','extrap');
+Pn= zeros(numStates,1); Pn(i0)= 1;
+c= 0;
+for j=1:numCycles,
+    for i=c+1:cycles(j), Pn= M'*Pn; end;
+    c= cycles(j);
+
+    % Spark state distribution
+    obs= accumarray(idxMC(j,:)',1,[numStates 1]);
+    [xv.spark.chi2(j),xv.spark.dof(j),xv.spark.pValue(j)]= chi2Test(obs,Pn,R);
+    xv.spark.meanMarkov(j)= theta'*Pn;
+    x= theta(idxMC(j,:));
+    xv.spark.meanMC(j)= mean(x);
+    xv.spark.ciMC(:,j)= mean(x) + [-z;z]*std(x)/sqrt(R);
+
+    % Distribution of the number of knock events in the first 'c' cycles
+    kmax= max(knkMC(j,:))+1;
+    [~,logPnk]= tailKnk(c,Madv,M-Madv,theta,kmax,theta(i0));
+    Pk= exp(logPnk(:));
+    obs= accumarray(knkMC(j,:)'+1,1,[kmax+1 1]);
+    [xv.knock.chi2(j),xv.knock.dof(j),xv.knock.pValue(j)]= chi2Test(obs,Pk,R);
+    xv.knock.meanMarkov(j)= [0:kmax-1]*Pk(1:kmax) + kmax*Pk(end);
+    x= knkMC(j,:);
+    xv.knock.meanMC(j)= mean(x);
+    xv.knock.ciMC(:,j)= mean(x) + [-z;z]*std(x)/sqrt(R);
+end;
+xv.cycles= cycles;
+xv.numRuns= R;
+xv.numTests= numTests;
+xv.pass= all([xv.spark.pValue, xv.knock.pValue] > alpha/numTests) && ...
+         all(abs([xv.spark.meanMarkov-xv.spark.meanMC, xv.knock.meanMarkov-xv.knock.meanMC]) <= ...
+             [diff(xv.spark.ciMC)/2, diff(xv.knock.ciMC)/2] + 1e-12);
+
+
+% Plot results if required
+if (nargout==0) || ((nargin>=10) && ~isempty(fig)),
+    figure, plot(cycles,xv.spark.meanMarkov,'-'); hold all;
+    errorbar(cycles,xv.spark.meanMC,xv.spark.meanMC-xv.spark.ciMC(1,:),xv.spark.ciMC(2,:)-xv.spark.meanMC,'o');
+    xlabel('Cycle number [-]');
+    ylabel('Mean relative spark angle [deg]');
+    legend('Markov','Monte Carlo');
+
+    figure, plot(cycles,xv.knock.meanMarkov,'-'); hold all;
+    errorbar(cycles,xv.knock.meanMC,xv.knock.meanMC-xv.knock.ciMC(1,:),xv.knock.ciMC(2,:)-xv.knock.meanMC,'o');
+    xlabel('Cycle number [-]');
+    ylabel('Mean number of knock events');
+    legend('Markov','Monte Carlo');
+end;
+
+
+
+function [X2,dof,pValue]= chi2Test(obs,P,R)
+
+% Pearson chi-square test of counts obs against probabilities P, pooling adjacent bins to E>=5
+E= R*P(:);
+obs= obs(:);
+group= zeros(size(E));
+g= 1; acc= 0;
+for i=1:length(E),
+    group(i)= g;
+    acc= acc + E(i);
+    if acc>=5, g= g+1; acc= 0; end;
+end;
+if acc>0 && acc<5 && g>1, group(group==g)= g-1; end;        % merge an undersized last group
+O1= accumarray(group,obs);
+E1= accumarray(group,E);
+keep= E1>0;
+X2= sum((O1(keep)-E1(keep)).^2./E1(keep));
+if any(O1(~keep)>0), X2= inf; end;                          % observed an impossible outcome
+dof= max(sum(keep)-1,1);
+pValue= gammainc(X2/2,dof/2,'upper');